@@ -1,21 +1,47 @@
 #include "cool-cgen.h"
+#include "cool-elf.h"
+#include "cool-void.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <climits>
+#include <iostream>
+#include <memory>
 #include <set>
-#include <stack>
 #include <string>
+#include <thread>
 
 class Environment {
+  /* Frame slot of a local variable or parameter, and whether it holds the raw
+   * value of an Int or Bool rather than the object */
+  struct Local {
+    int frameOffset;
+    bool unboxed;
+  };
+
   size_t numParams;
-  Symtab<int> locals;
+  /* Frame slot of the first local variable */
+  int firstLocal;
+  Symtab<Local> locals;
 
 public:
-  Environment(void) : numParams(0) {}
+  Environment(void) : numParams(0), firstLocal(-12) {}
 
-  explicit Environment(const std::vector<Symbol *> &params) : numParams(params.size()) {
+  explicit Environment(const std::vector<Symbol *> &params) : numParams(params.size()), firstLocal(-12) {
     for (size_t i = 0, n = params.size(); i < n; i++) {
-      locals.define(params[i], static_cast<int>(n - i) * 4);
+      locals.define(params[i], { static_cast<int>(n - i) * 4, false });
+    }
+  }
+
+  /**
+   * Environment of a method inlined into the frame of its caller: the
+   * parameters are local variables taking the slots from `frameOffset` down,
+   * followed by the local variables of the method.
+   */
+  Environment(const std::vector<Symbol *> &params, int frameOffset) : numParams(0), firstLocal(frameOffset) {
+    for (Symbol *param : params) {
+      alloc(param);
     }
   }
 
@@ -27,14 +53,27 @@ public:
     locals.leaveScope();
   }
 
-  int alloc(Symbol *name) {
-    int offset = -static_cast<int>(locals.size() - numParams) - 12;
-    locals.define(name, offset);
+  int alloc(Symbol *name, bool unboxed = false) {
+    int offset = firstLocal - static_cast<int>(locals.size() - numParams) * 4;
+    locals.define(name, { offset, unboxed });
     return offset;
   }
 
   bool getFrameOffset(Symbol *name, int &offset) const {
-    return locals.lookup(name, offset);
+    Local local;
+    if (locals.lookup(name, local)) {
+      offset = local.frameOffset;
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * @return whether `name` is a local variable holding a raw value.
+   */
+  bool isUnboxed(Symbol *name) const {
+    Local local;
+    return locals.lookup(name, local) && local.unboxed;
   }
 };
 
@@ -51,7 +90,126 @@ public:
   }
 };
 
-#define REGISTER(name) static const char *name = "$" #name
+/**
+ * Chooses the representation of the Int and Bool `let` variables of a method.
+ *
+ * A boxed variable allocates an object each time arithmetic computes a new
+ * value for it, while a raw one is boxed each time it escapes: when it is
+ * stored into an attribute, passed as an argument, returned, or used as the
+ * receiver of a dispatch. A variable is kept raw unless it escapes more often
+ * than it is computed, the uses in loops weighing more.
+ */
+class RepresentationContext {
+  struct Local {
+    const Definition *def;
+    unsigned long computed;
+    unsigned long escapes;
+  };
+
+  /* Index into `locals` of the variables in scope, -1 for the variables that
+   * are always boxed */
+  Symtab<int> scope;
+  std::vector<Local> locals;
+  unsigned int loopDepth;
+
+  unsigned long weight(void) const {
+    return 1ul << (3 * std::min(loopDepth, 6u));
+  }
+
+  Local *lookup(Symbol *name) {
+    int index;
+    if (scope.lookup(name, index) && index >= 0) {
+      return &locals[index];
+    }
+    return nullptr;
+  }
+
+public:
+  RepresentationContext(void) : loopDepth(0) {}
+
+  void enterScope(void) {
+    scope.enterScope();
+  }
+
+  void leaveScope(void) {
+    scope.leaveScope();
+  }
+
+  void enterLoop(void) {
+    loopDepth++;
+  }
+
+  void leaveLoop(void) {
+    loopDepth--;
+  }
+
+  /**
+   * @brief Bind `name` in the current scope.
+   * @param def the definition of the variable if it is a `let` variable,
+   * `nullptr` otherwise.
+   */
+  void define(Symbol *name, const Definition *def) {
+    if (def && (def->getType() == Symbol::Int || def->getType() == Symbol::Bool)) {
+      scope.define(name, static_cast<int>(locals.size()));
+      locals.push_back({ def, 0, 0 });
+    }
+    else {
+      scope.define(name, -1);
+    }
+  }
+
+  /**
+   * @return whether `name` may be kept raw.
+   */
+  bool isCandidate(Symbol *name) {
+    return lookup(name) != nullptr;
+  }
+
+  /**
+   * @brief Count a use of `name` as a raw value if `value`, as an object
+   * otherwise.
+   */
+  void use(Symbol *name, bool value) {
+    Local *local = lookup(name);
+    if (local && !value) {
+      local->escapes += weight();
+    }
+  }
+
+  /**
+   * @brief Count the assignment of `expr` to `name`.
+   */
+  void assign(Symbol *name, const Expression *expr) {
+    Local *local = lookup(name);
+    if (local && expr && computesValue(expr)) {
+      local->computed += weight();
+    }
+  }
+
+  /**
+   * @brief Add the variables to keep raw to `unboxed`.
+   */
+  void addUnboxed(std::unordered_set<const Definition *> &unboxed) const {
+    for (const Local &local : locals) {
+      if (local.escapes <= local.computed) {
+        unboxed.insert(local.def);
+      }
+    }
+  }
+
+private:
+  /**
+   * @return whether `expr` computes a raw value that `cgen` boxes.
+   */
+  static bool computesValue(const Expression *expr) {
+    return dynamic_cast<const Arithmetic *>(expr) ||
+      dynamic_cast<const Complement *>(expr) ||
+      dynamic_cast<const Comparison *>(expr) ||
+      dynamic_cast<const Not *>(expr);
+  }
+};
+
+#define REGISTER(name) static constexpr Reg name = Reg::name
 
 namespace registers {
   // constant 0
@@ -100,6 +258,105 @@ namespace registers {
   REGISTER(ra);
 }
 
+/**
+ * Call `f(i)` for every `i` below `n`, spread over `threads` threads.
+ */
+template <typename F>
+static void parallelFor(unsigned int threads, size_t n, F f) {
+  if (threads <= 1 || n <= 1) {
+    for (size_t i = 0; i < n; i++) {
+      f(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (unsigned int k = 0; k < threads && k < n; k++) {
+    workers.emplace_back([&] {
+      for (size_t i; (i = next++) < n; ) {
+        f(i);
+      }
+    });
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+void DispatchStats::print(std::ostream &out) const {
+  out << "devirtualized: " << devirtualized << " of " << sites << " dispatch sites";
+  if (sites > 0) {
+    out << " (" << devirtualized * 100 / sites << "%)";
+  }
+  out << std::endl;
+  out << "inline caches: " << cached << " of " << sites << " dispatch sites" << std::endl;
+  out << "tail calls: " << tailCalls << std::endl;
+  for (const auto &item : inlined) {
+    out << "inlined " << item.first << ": " << item.second << std::endl;
+  }
+}
+
+void VoidCheckStats::print(std::ostream &out) const {
+  out << "void checks eliminated: " << eliminated << " of " << checks << std::endl;
+}
+
+void FrameStats::print(std::ostream &out) const {
+  out << "frames elided: " << elided << " of " << methods << " methods" << std::endl;
+}
+
+/**
+ * @return the attributes of `classInfo`, the inherited ones included, in the
+ * order of the object layout, which is also the order of initialization.
+ */
+static std::vector<const AttributeInfo *> getLayout(const ClassInfo *classInfo) {
+  std::vector<const AttributeInfo *> layout(classInfo->wordSize);
+  for (; classInfo; classInfo = classInfo->base) {
+    for (const auto &item : classInfo->attributes) {
+      layout[item.second->wordOffset] = item.second;
+    }
+  }
+  return layout;
+}
+
+/**
+ * @brief Count the attributes at the start of `layout` whose value is known
+ * before the initialization method runs.
+ *
+ * With optimizations, the initializers that are literals, after folding, are
+ * baked into the prototype instead of being evaluated at each instantiation.
+ * That holds until the first other initializer: it may dispatch on self, and
+ * see or set the following attributes before they are initialized.
+ */
+static size_t countBaked(const CGenContext &context, const std::vector<const AttributeInfo *> &layout) {
+  if (!context.isOptimizing()) {
+    return 0;
+  }
+  size_t count = 0;
+  for (const AttributeInfo *attributeInfo : layout) {
+    const Expression *init = attributeInfo->init;
+    if (init && !dynamic_cast<const Integer *>(init) && !dynamic_cast<const String *>(init) && !dynamic_cast<const Boolean *>(init)) {
+      break;
+    }
+    count++;
+  }
+  return count;
+}
+
+/**
+ * @return whether the initialization method of `classInfo` does anything, or
+ * may be needed to: without optimizations, it is always called.
+ */
+static bool needsInit(const CGenContext &context, const ClassInfo *classInfo) {
+  std::vector<const AttributeInfo *> layout = getLayout(classInfo);
+  for (size_t i = countBaked(context, layout); i < layout.size(); i++) {
+    if (layout[i]->init) {
+      return true;
+    }
+  }
+  return !context.isOptimizing();
+}
+
 void CGenContext::cgen(const InheritanceTree &inheritanceTree, const std::vector<Program *> &programs) {
   // Perform code generation in two passes: The first pass decides the object
   // layout for each class, particularly the offset at which each attribute is
@@ -139,104 +396,64 @@ void CGenContext::cgen(const InheritanceTree &inheritanceTree, const std::vector
 
   emit_globl("class_objTab");
 
-  stream << "\t.text" << std::endl;
-
   // TODO: Primitives
 
+  // Every class is generated into a context of its own, possibly on several
+  // threads. The local labels and the constants of each context are then
+  // numbered as if the classes had been generated one after another, so the
+  // output does not depend on the number of threads.
+
+  // With optimizations, only the classes and methods the program may use
+  // are generated: a class without any object keeps its tag, but not its
+  // prototype nor its dispatch table, and its initialization method is only
+  // generated for the derived classes.
+  if (optimize) {
+    reachability = std::make_shared<ReachContext>(inheritanceTree);
+  }
+
+  std::vector<std::pair<const Program *, const ClassInfo *>> units;
+  std::unordered_map<Symbol *, const Program *> programsByClass;
   for (Program *program : programs) {
     for (Class *claSs : program->getClasses()) {
-      Symbol *typeName = claSs->getName();
-
-      const ClassInfo *classInfo = inheritanceTree.getClassInfo(typeName);
-
+      const ClassInfo *classInfo = inheritanceTree.getClassInfo(claSs->getName());
       classes.push_back(classInfo);
-
-      /* Initialization methods */
-
-      unsigned int locals = 0;
-      for (const auto &item : classInfo->attributes) {
-        const AttributeInfo *attributeInfo = item.second;
-        if (attributeInfo->locals > locals) {
-          locals = attributeInfo->locals;
-        }
-      }
-
-      Environment env;
-
-      emit_label(classInfo->typeName->to_string() + "_init");
-
-      emit_sw(registers::fp, registers::sp, 0);
-      emit_sw(registers::s0, registers::sp, -4);
-      emit_sw(registers::ra, registers::sp, -8);
-      emit_move(registers::fp, registers::sp);
-      emit_addiu(registers::sp, registers::sp, -12 - static_cast<int>(locals) * 4);
-
-      emit_move(registers::s0, registers::a0);
-
-      if (classInfo->base) {
-        emit_jal(classInfo->base->typeName->to_string() + "_init");
+      programsByClass.insert({ classInfo->typeName, program });
+      if (isGenerated(classInfo)) {
+        units.push_back({ program, classInfo });
       }
+    }
+  }
 
-      for (const auto &item : classInfo->attributes) {
-        const AttributeInfo *attributeInfo = item.second;
-        if (attributeInfo->init) {
-          attributeInfo->init->cgen(*this, inheritanceTree, program, typeName, env);
-          emit_sw(registers::a0, registers::s0, 12 + attributeInfo->wordOffset * 4);
-        }
-      }
-
-      // For the initialization methods, Coolaid andthe runtime system consider
-      // $a0 to be callee-saved (in addition to the callee - saved registers
-      // for normal methods).
-      emit_move(registers::a0, registers::s0);
-
-      emit_move(registers::sp, registers::fp);
-      emit_lw(registers::ra, registers::sp, -8);
-      emit_lw(registers::s0, registers::sp, -4);
-      emit_lw(registers::fp, registers::sp, 0);
-      emit_jr(registers::ra);
-
-      /* Methods */
-
-      for (const auto &item : classInfo->methods) {
-        Symbol *methodName = item.first;
-        const MethodInfo *methodInfo = item.second;
-
-        std::vector<Symbol *> params;
-        for (auto &paramDecl : methodInfo->methType.paramDecls) {
-          params.push_back(paramDecl.first);
-        }
-
-        Environment env(params);
-
-        emit_label(classInfo->typeName->to_string() + "." + methodName->to_string());
-
-        emit_sw(registers::fp, registers::sp, 0);
-        emit_sw(registers::s0, registers::sp, -4);
-        emit_sw(registers::ra, registers::sp, -8);
-        emit_move(registers::fp, registers::sp);
-        emit_addiu(registers::sp, registers::sp, -12 - static_cast<int>(methodInfo->locals) * 4);
-
-        emit_move(registers::s0, registers::a0);
+  shards.resize(units.size());
+  parallelFor(threads, units.size(), [&] (size_t i) {
+    shards[i].reset(new CGenContext(1, optimize));
+    shards[i]->reachability = reachability;
+    shards[i]->classPrograms = &programsByClass;
+    shards[i]->cgenClass(inheritanceTree, units[i].first, units[i].second);
+  });
 
-        methodInfo->expr->cgen(*this, inheritanceTree, program, typeName, env);
+  // The stubs of the out-of-line void checks follow the classes
+  if (optimize) {
+    shards.emplace_back(new CGenContext(1, optimize));
+    shards.back()->cgenAbortStubs();
+  }
 
-        emit_move(registers::sp, registers::fp);
-        emit_lw(registers::ra, registers::sp, -8);
-        emit_lw(registers::s0, registers::sp, -4);
-        emit_lw(registers::fp, registers::sp, 0);
-        emit_addiu(registers::sp, registers::sp, static_cast<int>(params.size()) * 4);
-        emit_jr(registers::ra);
-      }
-    }
+  labelBases.resize(shards.size());
+  for (size_t i = 0; i < shards.size(); i++) {
+    labelBases[i] = label;
+    label += shards[i]->label;
+    mergeConstants(*shards[i]);
+    peepholeStats.add(shards[i]->peepholeStats);
+    dispatchStats.add(shards[i]->dispatchStats);
+    voidCheckStats.add(shards[i]->voidCheckStats);
+    frameStats.add(shards[i]->frameStats);
   }
 
   std::sort(classes.begin(), classes.end(), [] (const ClassInfo *lhs, const ClassInfo *rhs) {
     return lhs->tag < rhs->tag;
   });
 
-  stream << "\t.data" << std::endl;
-  stream << "\t.align\t2" << std::endl;
+  emit_align(2);
 
   /* Constants */
 
@@ -252,24 +469,49 @@ void CGenContext::cgen(const InheritanceTree &inheritanceTree, const std::vector
   // Constants: class_nameTab
   emit_label("class_nameTab");
   for (const ClassInfo *classInfo : classes) {
-    emit_word(getConstantLabel(classInfo->typeName->to_string()));
+    if (isInstantiated(classInfo)) {
+      emit_word(getConstantLabel(classInfo->typeName->to_string()));
+    }
+    else {
+      emit_word(0);
+    }
   }
 
   // Constants: class_objTab
   emit_label("class_objTab");
   for (const ClassInfo *classInfo : classes) {
-    emit_word(classInfo->typeName->to_string() + "_protObj");
-    emit_word(classInfo->typeName->to_string() + "_init");
+    if (isInstantiated(classInfo)) {
+      emit_word(classInfo->typeName->to_string() + "_protObj");
+      emit_word(classInfo->typeName->to_string() + "_init");
+    }
+    else {
+      emit_word(0);
+      emit_word(0);
+    }
   }
 
+  // The slots of the methods that are never called keep the layout of the
+  // tables, with a method of the runtime that is always there.
+  GlobalLabel stub = getMethodLabel(Symbol::Object, Symbol::abort);
   for (const ClassInfo *classInfo : classes) {
+    if (!isInstantiated(classInfo)) {
+      continue;
+    }
     emit_label(classInfo->typeName->to_string() + "_dispTab");
-    for (const MethodInfo *methodInfo : classInfo->dispatchTable) {
-      emit_word(methodInfo->typeName->to_string() + "." + methodInfo->methName->to_string());
+    for (const MethodInfo *methodInfo : classInfo->getDispatchTable()) {
+      if (!methodInfo->expr || isReachable(methodInfo)) {
+        emit_word(getMethodLabel(methodInfo->typeName, methodInfo->methName));
+      }
+      else {
+        emit_word(stub);
+      }
     }
   }
 
   for (const ClassInfo *classInfo : classes) {
+    if (!isInstantiated(classInfo)) {
+      continue;
+    }
     emit_word(-1);
     emit_label(classInfo->typeName->to_string() + "_protObj");
     emit_word(classInfo->tag);
@@ -285,54 +527,69 @@ void CGenContext::cgen(const InheritanceTree &inheritanceTree, const std::vector
       }
     }
     else {
-      std::stack<const ClassInfo *> ancestors;
-      for (const ClassInfo *iter = classInfo; iter; iter = iter->base) {
-        ancestors.push(iter);
-      }
-
-      while (!ancestors.empty()) {
-        const ClassInfo *classInfo = ancestors.top();
-        ancestors.pop();
-
-        for (auto &item : classInfo->attributes) {
-          const AttributeInfo *attributeInfo = item.second;
-          if (attributeInfo->attrType == Symbol::Int) {
-            emit_word(getConstantLabel(0));
-          }
-          else if (attributeInfo->attrType == Symbol::String) {
-            emit_word(getConstantLabel(""));
-          }
-          else if (attributeInfo->attrType == Symbol::Bool) {
-            emit_word("bool_const0");
-          }
-          else {
-            emit_word(0);
-          }
+      std::vector<const AttributeInfo *> layout = getLayout(classInfo);
+      size_t baked = countBaked(*this, layout);
+      for (size_t i = 0; i < layout.size(); i++) {
+        const AttributeInfo *attributeInfo = layout[i];
+        const Expression *init = i < baked ? attributeInfo->init : nullptr;
+        if (const Integer *integer = dynamic_cast<const Integer *>(init)) {
+          emit_word(getConstantLabel(integer->getValue()));
+        }
+        else if (const String *str = dynamic_cast<const String *>(init)) {
+          emit_word(getConstantLabel(str->getValue()));
+        }
+        else if (const Boolean *boolean = dynamic_cast<const Boolean *>(init)) {
+          emit_word(boolean->getValue() ? "bool_const1" : "bool_const0");
+        }
+        else if (attributeInfo->attrType == Symbol::Int) {
+          emit_word(getConstantLabel(0));
+        }
+        else if (attributeInfo->attrType == Symbol::String) {
+          emit_word(getConstantLabel(""));
+        }
+        else if (attributeInfo->attrType == Symbol::Bool) {
+          emit_word("bool_const0");
+        }
+        else {
+          emit_word(0);
         }
       }
     }
   }
 
-  for (auto &item : strConstants) {
-    unsigned int size = static_cast<unsigned int>(item.first.size());
+  // The constants are emitted in the order of their labels rather than in
+  // the hash order of the maps, which depends on the standard library.
+  // String constants add the constants of their lengths, so they go first.
+  std::vector<std::pair<GlobalLabel, const std::string *>> strs;
+  for (const auto &item : strConstants) {
+    strs.push_back({ item.second, &item.first });
+  }
+  std::sort(strs.begin(), strs.end());
+  for (const auto &item : strs) {
+    unsigned int size = static_cast<unsigned int>(item.second->size());
     emit_word(-1);
-    emit_label(item.second);
+    emit_label(item.first);
     emit_word(String_classInfo->tag);
     emit_word(3 + 1 + (size + 1) / 4);
     emit_word(Symbol::String->to_string() + "_dispTab");
     emit_word(getConstantLabel(size));
-    emit_ascii(item.first);
+    emit_ascii(*item.second);
     emit_byte(0);
     emit_align(2);
   }
 
-  for (auto &item : intConstants) {
+  std::vector<std::pair<GlobalLabel, int>> ints;
+  for (const auto &item : intConstants) {
+    ints.push_back({ item.second, item.first });
+  }
+  std::sort(ints.begin(), ints.end());
+  for (const auto &item : ints) {
     emit_word(-1);
-    emit_label(item.second);
+    emit_label(item.first);
     emit_word(Int_classInfo->tag);
     emit_word(3 + Int_classInfo->wordSize);
     emit_word(Symbol::Int->to_string() + "_dispTab");
-    emit_word(item.first);
+    emit_word(item.second);
   }
 
   emit_word(-1);
@@ -348,335 +605,1963 @@ void CGenContext::cgen(const InheritanceTree &inheritanceTree, const std::vector
   emit_word(3 + Bool_classInfo->wordSize);
   emit_word(Symbol::Bool->to_string() + "_dispTab");
   emit_word(1);
-}
 
-void CGenContext::emit_ascii(const std::string &value) {
-  static const char *digits = "0123456789abcdef";
-  stream << "\t.ascii\t\"";
-  for (unsigned char c : value) {
-    switch (c) {
-    case '\0':
-      stream << "\\0";
-      break;
-    case '\a':
-      stream << "\\a";
-      break;
-    case '\b':
-      stream << "\\b";
-      break;
-    case '\t':
-      stream << "\\t";
-      break;
-    case '\v':
-      stream << "\\v";
-      break;
-    case '\f':
-      stream << "\\f";
-      break;
-    case '\n':
-      stream << "\\n";
-      break;
-    case '\r':
-      stream << "\\r";
-      break;
-    case '"':
-      stream << "\\\"";
-      break;
-    case '\\':
-      stream << "\\\\";
-      break;
-    default:
-      if (std::isprint(c)) {
-        stream << static_cast<char>(c);
-      }
-      else {
-        stream << "\\x" << digits[c / 4] << digits[c % 16];
+  // Jump tables of the methods
+  for (const std::unique_ptr<CGenContext> &shard : shards) {
+    for (const DataItem &item : shard->data) {
+      GlobalLabel sym = item.sym == GlobalLabel::none ? GlobalLabel::none : getLabel(shard->getLabelName(item.sym));
+      data.push_back({ item.op, item.value, sym, item.text });
+    }
+  }
+
+  // Source lines of the out-of-line void checks
+  if (optimize) {
+    emit_label("_abort_lines");
+    for (const std::unique_ptr<CGenContext> &shard : shards) {
+      for (const DataItem &item : shard->lineTable) {
+        GlobalLabel sym = item.sym == GlobalLabel::none ? GlobalLabel::none : getLabel(shard->getLabelName(item.sym));
+        data.push_back({ item.op, item.value, sym, item.text });
       }
-      break;
     }
   }
-  stream << "\"" << std::endl;
 }
 
-void Assign::cgen(
-  CGenContext &context,
-  const InheritanceTree &inheritanceTree,
-  const Program *program,
-  Symbol *currentType,
-  Environment &env) const {
-  expr->cgen(context, inheritanceTree, program, currentType, env);
-
-  int frameOffset;
-  if (env.getFrameOffset(left, frameOffset)) {
-    context.emit_sw(registers::a0, registers::fp, frameOffset);
-  }
-  else if (const AttributeInfo *attributeInfo = inheritanceTree.getAttributeInfo(currentType, left)) {
-    context.emit_sw(registers::a0, registers::s0, 12 + attributeInfo->wordOffset * 4);
+bool CGenContext::isGenerated(const ClassInfo *classInfo) const {
+  if (isInitialized(classInfo)) {
+    return true;
   }
-  else {
-    assert(false);
+  for (const MethodInfo *methodInfo : classInfo->ownMethods) {
+    if (isReachable(methodInfo)) {
+      return true;
+    }
   }
+  return false;
 }
 
-void Dispatch::cgen(
-  CGenContext &context,
-  const InheritanceTree &inheritanceTree,
-  const Program *program,
-  Symbol *currentType,
-  Environment &env) const {
-  unsigned int label = context.newLabel();
+void CGenContext::cgenClass(const InheritanceTree &inheritanceTree, const Program *program, const ClassInfo *classInfo) {
+  Symbol *typeName = classInfo->typeName;
 
-  for (Expression *arg : args) {
-    arg->cgen(context, inheritanceTree, program, currentType, env);
-    context.emit_sw(registers::a0, registers::sp, 0);
-    context.emit_addiu(registers::sp, registers::sp, -4);
-  }
+  /* Initialization methods */
 
-  Symbol *dispatchType = nullptr;
-  if (expr) {
-    expr->cgen(context, inheritanceTree, program, currentType, env);
-    dispatchType = expr->getStaticType();
-  }
-  else {
-    context.emit_move(registers::a0, registers::s0);
-    dispatchType = currentType;
-  }
+  if (isInitialized(classInfo)) {
+    // The attributes the class defines itself, whose initializers are not
+    // baked into the prototype
+    std::vector<const AttributeInfo *> layout = getLayout(classInfo);
+    std::vector<const AttributeInfo *> attributes;
+    for (size_t i = countBaked(*this, layout); i < layout.size(); i++) {
+      if (layout[i]->typeName == typeName && layout[i]->init) {
+        attributes.push_back(layout[i]);
+      }
+    }
+
+    unsigned int locals = 0;
+    std::vector<const Expression *> inits;
+    for (const AttributeInfo *attributeInfo : attributes) {
+      if (attributeInfo->locals > locals) {
+        locals = attributeInfo->locals;
+      }
+      inits.push_back(attributeInfo->init);
+    }
 
-  // Runtime error check: dispatch on void
-  context.emit_bne(registers::a0, registers::zero, label);
-  context.emit_la(registers::a0, context.getConstantLabel(program->getName()));
-  context.emit_li(registers::t1, program->getLine(this));
-  context.emit_jal("_dispatch_abort");
+    Environment env;
 
-  context.emit_label(label);
-  if (type) {
-    context.emit_jal(type->to_string() + "." + name->to_string());
-  }
-  else {
-    const MethodInfo *methodInfo = inheritanceTree.getMethodInfo(currentType, name);
-    context.emit_lw(registers::t1, registers::a0, 8);
-    context.emit_lw(registers::t1, registers::t1, methodInfo->index * 4);
-    context.emit_jalr(registers::t1);
+    beginMethod(getInitLabel(classInfo->typeName));
+    emit_prologue(locals);
+    chooseRepresentations(inits);
+    findUnchecked(inits);
+
+    if (classInfo->base && needsInit(*this, classInfo->base)) {
+      emit_jal(getInitLabel(classInfo->base->typeName));
+    }
+
+    for (const AttributeInfo *attributeInfo : attributes) {
+      attributeInfo->init->cgen(*this, inheritanceTree, program, typeName, env);
+      emit_sw(registers::a0, registers::s0, 12 + attributeInfo->wordOffset * 4);
+    }
+
+    // For the initialization methods, Coolaid andthe runtime system consider
+    // $a0 to be callee-saved (in addition to the callee - saved registers
+    // for normal methods).
+    emit_move(registers::a0, registers::s0);
+
+    emit_epilogue(0);
+    endMethod();
   }
-}
 
-void Conditional::cgen(
-  CGenContext &context,
-  const InheritanceTree &inheritanceTree,
-  const Program *program,
-  Symbol *currentType,
-  Environment &env) const {
-  unsigned int false_branch = context.newLabel();
-  unsigned int end_if = context.newLabel();
+  /* Methods */
 
-  pred->cgen(context, inheritanceTree, program, currentType, env);
-  context.emit_lw(registers::t1, registers::a0, 12);
-  context.emit_beq(registers::t1, registers::zero, false_branch);
-  then->cgen(context, inheritanceTree, program, currentType, env);
-  context.emit_j(end_if);
-  context.emit_label(false_branch);
-  elSe->cgen(context, inheritanceTree, program, currentType, env);
-  context.emit_label(end_if);
-}
+  for (const MethodInfo *methodInfo : classInfo->ownMethods) {
+    Symbol *methodName = methodInfo->methName;
+    if (!isReachable(methodInfo)) {
+      continue;
+    }
 
-void Loop::cgen(
-  CGenContext &context,
-  const InheritanceTree &inheritanceTree,
-  const Program *program,
-  Symbol *currentType,
-  Environment &env) const {
-  unsigned int repeat = context.newLabel();
-  unsigned int end_loop = context.newLabel();
+    std::vector<Symbol *> params;
+    for (auto &paramDecl : methodInfo->methType.paramDecls) {
+      params.push_back(paramDecl.first);
+    }
 
-  context.emit_label(repeat);
-  pred->cgen(context, inheritanceTree, program, currentType, env);
-  context.emit_lw(registers::t1, registers::a0, 12);
-  context.emit_beq(registers::t1, registers::zero, end_loop);
-  body->cgen(context, inheritanceTree, program, currentType, env);
-  context.emit_j(repeat);
-  context.emit_label(end_loop);
-  context.emit_move(registers::a0, registers::zero);
+    Environment env(params);
+
+    beginMethod(getLabel(classInfo->typeName->to_string() + "." + methodName->to_string()), methodInfo);
+    emit_prologue(methodInfo->locals);
+    chooseRepresentations({ methodInfo->expr });
+    findUnchecked({ methodInfo->expr });
+    findTailCalls(methodInfo->expr);
+
+    methodInfo->expr->cgen(*this, inheritanceTree, program, typeName, env);
+
+    emit_epilogue(static_cast<unsigned int>(params.size()));
+    endMethod();
+  }
 }
 
-void Block::cgen(
-  CGenContext &context,
-  const InheritanceTree &inheritanceTree,
-  const Program *program,
-  Symbol *currentType,
-  Environment &env) const {
-  for (Expression *expr : exprs) {
-    expr->cgen(context, inheritanceTree, program, currentType, env);
+void CGenContext::cgenAbortStubs(void) {
+  // Each entry of the table holds the return address of a call, followed by
+  // its line and file name. The return address of the stub is in the table.
+  const std::pair<const char *, const char *> stubs[] = {
+    { "_dispatch_void", "_dispatch_abort" },
+    { "_case_void", "_case_abort2" },
+  };
+  for (const auto &item : stubs) {
+    code.clear();
+    code.name = getLabel(item.first);
+    unsigned int loop = newLabel();
+    emit_la(registers::t1, getLabel("_abort_lines"));
+    emit_label(loop);
+    emit_lw(registers::t2, registers::t1, 0);
+    emit_addiu(registers::t1, registers::t1, 12);
+    emit_bne(registers::t2, registers::ra, loop);
+    emit_lw(registers::a0, registers::t1, -4);
+    emit_lw(registers::t1, registers::t1, -8);
+    emit_j(getLabel(item.second));
+    methods.push_back(std::move(code));
   }
+  code.clear();
 }
 
-void Definition::cgen(
-  CGenContext &context,
-  const InheritanceTree &inheritanceTree,
-  const Program *program,
-  Symbol *currentType,
-  Environment &env) const {
-  if (init) {
-    init->cgen(context, inheritanceTree, program, currentType, env);
-    int frameOffset = env.alloc(name);
-    context.emit_sw(registers::a0, registers::fp, frameOffset);
+void CGenContext::emitAbortCalls(void) {
+  for (const AbortCall &call : abortCalls) {
+    GlobalLabel returnLabel = newCodeLabel("abort");
+    emit_label(call.label);
+    emit_jal(call.stub);
+    emit_code_label(returnLabel);
+    lineTable.push_back({ DataOp::word, 0, returnLabel, std::string() });
+    lineTable.push_back({ DataOp::word, call.line, GlobalLabel::none, std::string() });
+    lineTable.push_back({ DataOp::word, 0, call.fileName, std::string() });
   }
-  else {
-    env.alloc(name);
+}
+
+GlobalLabel CGenContext::newJumpTable(const std::vector<GlobalLabel> &targets) {
+  GlobalLabel table = getLabel(getLabelName(code.name) + ".table" + std::to_string(codeLabels++));
+  emit_label(table);
+  for (GlobalLabel target : targets) {
+    emit_word(target);
   }
+  return table;
 }
 
-void Let::cgen(
-  CGenContext &context,
-  const InheritanceTree &inheritanceTree,
-  const Program *program,
-  Symbol *currentType,
-  Environment &env) const {
-  EnvironmentGuard eg(env);
+void CGenContext::mergeConstants(CGenContext &shard) {
+  // Visit the constants of the shard in the order of their first use, which is
+  // also the order of their label ids, and rename their labels after the
+  // constants of this context.
 
-  for (Definition *def : defs) {
-    def->cgen(context, inheritanceTree, program, currentType, env);
+  std::vector<std::pair<GlobalLabel, const std::string *>> strs;
+  for (const auto &item : shard.strConstants) {
+    strs.push_back({ item.second, &item.first });
+  }
+  std::sort(strs.begin(), strs.end());
+  for (const auto &item : strs) {
+    shard.labelNames[static_cast<unsigned int>(item.first)] = getLabelName(getConstantLabel(*item.second));
   }
-  body->cgen(context, inheritanceTree, program, currentType, env);
-}
 
-void Branch::cgen(
+  std::vector<std::pair<GlobalLabel, int>> ints;
+  for (const auto &item : shard.intConstants) {
+    ints.push_back({ item.second, item.first });
+  }
+  std::sort(ints.begin(), ints.end());
+  for (const auto &item : ints) {
+    shard.labelNames[static_cast<unsigned int>(item.first)] = getLabelName(getConstantLabel(item.second));
+  }
+}
+
+bool CGenContext::write(std::ostream &out) const {
+  OutBuffer header;
+  for (GlobalLabel label : globals) {
+    header << "\t.globl\t" << getLabelName(label) << '\n';
+  }
+  header << "\t.text\n";
+  if (!header.write(out)) {
+    return false;
+  }
+
+  std::vector<OutBuffer> text;
+  text.reserve(shards.size());
+  for (size_t i = 0; i < shards.size(); i++) {
+    text.emplace_back(0);
+  }
+  parallelFor(threads, shards.size(), [&] (size_t i) {
+    for (const MethodCode &method : shards[i]->methods) {
+      method.print(text[i], shards[i]->labelNames, labelBases[i]);
+    }
+  });
+  for (const OutBuffer &buffer : text) {
+    if (!buffer.write(out)) {
+      return false;
+    }
+  }
+
+  OutBuffer footer;
+  footer << "\t.data\n";
+  for (const DataItem &item : data) {
+    printDataItem(footer, item, labelNames);
+  }
+  return footer.write(out);
+}
+
+bool CGenContext::writeObject(std::ostream &out) const {
+  std::vector<MachineCode> text(shards.size());
+  std::vector<GlobalLabel> unreachable(shards.size(), GlobalLabel::none);
+  parallelFor(threads, shards.size(), [&] (size_t i) {
+    for (const MethodCode &method : shards[i]->methods) {
+      if (!method.encode(text[i])) {
+        unreachable[i] = method.name;
+      }
+    }
+  });
+
+  ElfWriter writer;
+  for (size_t i = 0; i < shards.size(); i++) {
+    if (unreachable[i] != GlobalLabel::none) {
+      std::cerr << "Branch out of range in " << shards[i]->getLabelName(unreachable[i]) << std::endl;
+      return false;
+    }
+    writer.append(ElfWriter::TEXT, text[i], shards[i]->labelNames);
+  }
+
+  MachineCode dataCode;
+  encodeData(data, dataCode);
+  writer.append(ElfWriter::DATA, dataCode, labelNames);
+
+  for (GlobalLabel label : globals) {
+    writer.setGlobal(writer.getSymbol(getLabelName(label)));
+  }
+
+  return writer.write(out);
+}
+
+void CGenContext::emit_prologue(unsigned int locals) {
+  frameLocals = locals;
+
+  emit_sw(registers::fp, registers::sp, 0);
+  emit_sw(registers::s0, registers::sp, -4);
+  emit_sw(registers::ra, registers::sp, -8);
+  emit_move(registers::fp, registers::sp);
+  frameSetup = code.instructions.size();
+  emit_addiu(registers::sp, registers::sp, -12 - static_cast<int>(locals) * 4);
+
+  emit_move(registers::s0, registers::a0);
+  frameEntry = code.instructions.size();
+}
+
+void CGenContext::emit_epilogue(unsigned int params) {
+  frameTeardowns.push_back(code.instructions.size());
+  emit_move(registers::sp, registers::fp);
+  emit_lw(registers::ra, registers::sp, -8);
+  emit_lw(registers::s0, registers::sp, -4);
+  emit_lw(registers::fp, registers::sp, 0);
+  if (params > 0) {
+    emit_addiu(registers::sp, registers::sp, static_cast<int>(params) * 4);
+  }
+  emit_jr(registers::ra);
+}
+
+void CGenContext::emit_tail_epilogue(unsigned int argc) {
+  int params = static_cast<int>(inlining.front()->methType.paramDecls.size());
+  int args = static_cast<int>(argc);
+
+  frameTeardowns.push_back(code.instructions.size());
+  emit_lw(registers::ra, registers::fp, -8);
+  emit_lw(registers::s0, registers::fp, -4);
+  // The arguments of the call end where the ones of the method do, there are
+  // no more of them: copying from the highest address down never overwrites
+  // an argument before reading it.
+  for (int i = 0; i < args; i++) {
+    emit_lw(registers::t1, registers::sp, 4 * (args - i));
+    emit_sw(registers::t1, registers::fp, 4 * (params - i));
+  }
+  if (params > args) {
+    emit_addiu(registers::sp, registers::fp, 4 * (params - args));
+  }
+  else {
+    emit_move(registers::sp, registers::fp);
+  }
+  emit_lw(registers::fp, registers::fp, 0);
+}
+
+void CGenContext::emit_self_tail_call(unsigned int argc) {
+  int args = static_cast<int>(argc);
+  for (int i = 0; i < args; i++) {
+    emit_lw(registers::t1, registers::sp, 4 * (args - i));
+    emit_sw(registers::t1, registers::fp, 4 * (args - i));
+  }
+  if (args > 0) {
+    emit_addiu(registers::sp, registers::sp, 4 * args);
+  }
+  emit_move(registers::s0, registers::a0);
+
+  if (!entryUsed) {
+    entryLabel = newLabel();
+    entryUsed = true;
+  }
+  emit_j(entryLabel);
+}
+
+void CGenContext::endMethod(void) {
+  frameStats.methods++;
+  if (optimize && elideFrame()) {
+    frameStats.elided++;
+  }
+  else {
+    completeFrame();
+  }
+  emitAbortCalls();
+
+  if (optimize) {
+    peephole(code, peepholeStats);
+  }
+  methods.push_back(std::move(code));
+  code.clear();
+}
+
+bool CGenContext::elideFrame(void) {
+  if (frameLocals > 0 || maxSpills > 0 || maxSavedTemporaries > 0 || frameTeardowns.size() != 1 || entryUsed) {
+    return false;
+  }
+
+  // The body lies between the frame setup and the single teardown. Only the
+  // runtime error routines, which never return, may be called.
+  std::vector<Instruction> &instructions = code.instructions;
+  size_t first = frameEntry;
+  size_t last = frameTeardowns.front();
+  bool usesSelf = false;
+  // Self may stay in $a0 if the straight-line code at the start of the body
+  // reads it before $a0 changes, and nothing else does
+  bool selfInA0 = true;
+  bool a0Changed = false;
+  for (size_t i = first; i < last; i++) {
+    const Instruction &instruction = instructions[i];
+    if (instruction.opcode == Opcode::jalr) {
+      return false;
+    }
+    if (instruction.opcode == Opcode::jal) {
+      const std::string &name = getLabelName(instruction.sym);
+      if (name != "_dispatch_abort" && name != "_case_abort" && name != "_case_abort2") {
+        return false;
+      }
+    }
+
+    Reg written = writtenRegister(instruction);
+    if (written == Reg::sp || written == Reg::fp || written == Reg::t0 || readsRegister(instruction, Reg::t0)) {
+      return false;
+    }
+    if (readsRegister(instruction, Reg::fp) &&
+        !((instruction.opcode == Opcode::lw || instruction.opcode == Opcode::sw) &&
+          instruction.rs == Reg::fp && instruction.rt != Reg::fp && instruction.imm > 0)) {
+      return false;
+    }
+    if (written == Reg::s0 || readsRegister(instruction, Reg::s0)) {
+      usesSelf = true;
+      selfInA0 = selfInA0 && !a0Changed && written != Reg::s0;
+    }
+    a0Changed = a0Changed || written == Reg::a0 || isControl(instruction);
+  }
+  Reg self = selfInA0 ? Reg::a0 : Reg::t0;
+
+  // Without a frame, $sp keeps the value $fp would have
+  std::vector<Instruction> body;
+  if (usesSelf && self != Reg::a0) {
+    body.push_back({ Opcode::move, self, Reg::a0, Reg::zero, 0, GlobalLabel::none });
+  }
+  for (size_t i = first; i < last; i++) {
+    Instruction instruction = instructions[i];
+    for (Reg *reg : { &instruction.rd, &instruction.rs, &instruction.rt }) {
+      if (*reg == Reg::s0) {
+        *reg = self;
+      }
+      else if (*reg == Reg::fp) {
+        *reg = Reg::sp;
+      }
+    }
+    body.push_back(instruction);
+  }
+  // The teardown ends with popping the arguments and the return
+  body.insert(body.end(), instructions.begin() + last + 4, instructions.end());
+
+  instructions = std::move(body);
+  return true;
+}
+
+void CGenContext::completeFrame(void) {
+  // The frame grows by the spill slots, followed by the save area of the
+  // callee-saved registers used for temporaries.
+  unsigned int slots = frameLocals + maxSpills;
+  if (maxSpills > 0 || maxSavedTemporaries > 0) {
+    code.instructions[frameSetup].imm = -12 - static_cast<int>(slots + maxSavedTemporaries) * 4;
+  }
+
+  std::vector<Instruction> saves;
+  std::vector<Instruction> restores;
+  for (unsigned int i = 0; i < maxSavedTemporaries; i++) {
+    Reg reg = static_cast<Reg>(static_cast<unsigned int>(Reg::s1) + i);
+    int offset = -12 - static_cast<int>(slots + i) * 4;
+    saves.push_back({ Opcode::sw, Reg::zero, Reg::fp, reg, offset, GlobalLabel::none });
+    restores.push_back({ Opcode::lw, Reg::zero, Reg::fp, reg, offset, GlobalLabel::none });
+  }
+
+  // Insert from the end of the method so that the positions still hold. The
+  // tail calls of the method to itself loop back after the saves, which keep
+  // the values of the registers for the caller.
+  std::vector<Instruction> &instructions = code.instructions;
+  for (auto iter = frameTeardowns.rbegin(), last = frameTeardowns.rend(); iter != last; iter++) {
+    instructions.insert(instructions.begin() + *iter, restores.begin(), restores.end());
+  }
+  if (entryUsed) {
+    Instruction label = { Opcode::label, Reg::zero, Reg::zero, Reg::zero, static_cast<int>(entryLabel), GlobalLabel::none };
+    instructions.insert(instructions.begin() + frameEntry, label);
+  }
+  instructions.insert(instructions.begin() + frameSetup + 1, saves.begin(), saves.end());
+}
+
+void CGenContext::chooseRepresentations(const std::vector<const Expression *> &exprs) {
+  if (!optimize) {
+    return;
+  }
+
+  RepresentationContext representations;
+  for (const Expression *expr : exprs) {
+    expr->countUses(representations, false);
+  }
+  representations.addUnboxed(unboxedLocals);
+}
+
+void CGenContext::findUnchecked(const std::vector<const Expression *> &exprs) {
+  if (optimize) {
+    findNonVoid(exprs, unchecked);
+  }
+}
+
+void CGenContext::emit_void_check(const std::string &routine, const std::string &stub, GlobalLabel fileName, int line) {
+  if (!optimize) {
+    unsigned int label = newLabel();
+    emit_bne(registers::a0, registers::zero, label);
+    emit_la(registers::a0, fileName);
+    emit_li(registers::t1, line);
+    emit_jal(getLabel(routine));
+    emit_label(label);
+    return;
+  }
+
+  GlobalLabel stubLabel = getLabel(stub);
+  auto iter = std::find_if(abortCalls.begin(), abortCalls.end(), [&] (const AbortCall &call) {
+    return call.stub == stubLabel && call.fileName == fileName && call.line == line;
+  });
+  if (iter == abortCalls.end()) {
+    abortCalls.push_back({ newLabel(), stubLabel, fileName, line });
+    iter = abortCalls.end() - 1;
+  }
+  emit_beq(registers::a0, registers::zero, iter->label);
+}
+
+void CGenContext::findTailCalls(const Expression *expr) {
+  if (optimize) {
+    expr->findTailCalls(tailCalls.back());
+  }
+}
+
+bool CGenContext::canInline(const MethodInfo *methodInfo) const {
+  static const unsigned int INLINE_BUDGET = 16; // Nodes of the inlined body
+  static const size_t INLINE_DEPTH = 3;
+
+  if (!optimize || !methodInfo->expr || inlining.size() > INLINE_DEPTH) {
+    return false;
+  }
+  // Recursion guard
+  if (std::find(inlining.cbegin(), inlining.cend(), methodInfo) != inlining.cend()) {
+    return false;
+  }
+  return methodInfo->expr->cost() <= INLINE_BUDGET;
+}
+
+void CGenContext::enterInline(const MethodInfo *methodInfo, bool tail) {
+  inlining.push_back(methodInfo);
+  tailCalls.emplace_back();
+  if (tail) {
+    methodInfo->expr->findTailCalls(tailCalls.back());
+  }
+  dispatchStats.inlined[methodInfo->typeName->to_string() + "." + methodInfo->methName->to_string()]++;
+}
+
+Temporary CGenContext::allocTemporary(bool acrossCalls) {
+  static const unsigned int SCRATCH_REGISTERS = 5; // $t5-$t9
+  static const unsigned int SAVED_REGISTERS = 6;   // $s1-$s6, $s7 belongs to the garbage collector
+
+  if (optimize) {
+    if (!acrossCalls && scratchTemporaries < SCRATCH_REGISTERS) {
+      static const Reg scratch[SCRATCH_REGISTERS] = { Reg::t5, Reg::t6, Reg::t7, Reg::t8, Reg::t9 };
+      return { scratch[scratchTemporaries++], 0 };
+    }
+    if (savedTemporaries < SAVED_REGISTERS) {
+      Reg reg = static_cast<Reg>(static_cast<unsigned int>(Reg::s1) + savedTemporaries++);
+      maxSavedTemporaries = std::max(maxSavedTemporaries, savedTemporaries);
+      return { reg, 0 };
+    }
+  }
+
+  int offset = -12 - static_cast<int>(frameLocals + spills++) * 4;
+  maxSpills = std::max(maxSpills, spills);
+  return { Reg::zero, offset };
+}
+
+int CGenContext::allocFrameSlots(unsigned int count) {
+  int offset = -12 - static_cast<int>(frameLocals + spills) * 4;
+  spills += count;
+  maxSpills = std::max(maxSpills, spills);
+  return offset;
+}
+
+void CGenContext::freeTemporary(const Temporary &temporary) {
+  if (temporary.reg == Reg::zero) {
+    spills--;
+  }
+  else if (temporary.reg >= Reg::s1 && temporary.reg <= Reg::s6) {
+    savedTemporaries--;
+  }
+  else {
+    scratchTemporaries--;
+  }
+}
+
+void CGenContext::emit_store(const Temporary &temporary, Reg src) {
+  if (temporary.reg == Reg::zero) {
+    emit_sw(src, registers::fp, static_cast<short>(temporary.frameOffset));
+  }
+  else if (temporary.reg != src) {
+    emit_move(temporary.reg, src);
+  }
+}
+
+Reg CGenContext::emit_load(const Temporary &temporary, Reg scratch) {
+  if (temporary.reg == Reg::zero) {
+    emit_lw(scratch, registers::fp, static_cast<short>(temporary.frameOffset));
+    return scratch;
+  }
+  return temporary.reg;
+}
+
+static bool isValueType(Symbol *type) {
+  return type == Symbol::Int || type == Symbol::Bool;
+}
+
+/**
+ * Load the constant `value` into `reg`.
+ */
+static void loadImmediate(CGenContext &context, Reg reg, int value) {
+  if (value >= -0x8000 && value <= 0x7fff) {
+    context.emit_li(reg, static_cast<short>(value));
+  }
+  else {
+    context.emit_lui(reg, static_cast<unsigned short>(static_cast<unsigned int>(value) >> 16));
+    context.emit_ori(reg, reg, static_cast<unsigned short>(value & 0xffff));
+  }
+}
+
+/**
+ * @brief Allocate a copy of the prototype of the class `typeName`, an object
+ * of `words` words, into $a0 like `Object.copy`.
+ *
+ * With optimizations, small objects are carved out of the heap inline: $gp
+ * is bumped past the garbage collector tag and the object, and the prototype
+ * is copied with unrolled loads and stores. The runtime only takes over,
+ * collecting garbage, when that would reach the limit in $s7. The scratch
+ * temporaries are left alone either way.
+ */
+static void allocate(CGenContext &context, Symbol *typeName, unsigned int words) {
+  static const unsigned int INLINE_WORDS = 16; // Largest object copied inline
+
+  GlobalLabel protObj = context.getProtObjLabel(typeName);
+  if (!context.isOptimizing() || words > INLINE_WORDS) {
+    context.emit_la(registers::a0, protObj);
+    context.emit_jal(context.getLabel("Object.copy"));
+    return;
+  }
+
+  unsigned int slow = context.newLabel();
+  unsigned int done = context.newLabel();
+  context.emit_addiu(registers::t1, registers::gp, 4 * static_cast<int>(words + 1));
+  context.emit_bge(registers::t1, registers::s7, slow);
+  context.emit_la(registers::t2, protObj);
+  context.emit_li(registers::a0, -1);
+  context.emit_sw(registers::a0, registers::gp, 0);
+  for (unsigned int i = 0; i < words; i++) {
+    context.emit_lw(registers::a0, registers::t2, 4 * static_cast<int>(i));
+    context.emit_sw(registers::a0, registers::gp, 4 * static_cast<int>(i + 1));
+  }
+  context.emit_addiu(registers::a0, registers::gp, 4);
+  context.emit_move(registers::gp, registers::t1);
+  context.emit_j(done);
+
+  context.emit_label(slow);
+  context.emit_la(registers::a0, protObj);
+  context.emit_jal(context.getLabel("Object.copy"));
+  context.emit_label(done);
+}
+
+/**
+ * Box the raw value of type `type`, Int or Bool, in $a0 into an object.
+ */
+static void boxValue(CGenContext &context, Symbol *type) {
+  if (type == Symbol::Bool) {
+    unsigned int label = context.newLabel();
+    context.emit_move(registers::t1, registers::a0);
+    context.emit_la(registers::a0, context.getLabel("bool_const0"));
+    context.emit_beq(registers::t1, registers::zero, label);
+    context.emit_la(registers::a0, context.getLabel("bool_const1"));
+    context.emit_label(label);
+  }
+  else {
+    // The allocation leaves the scratch temporaries alone. An Int object
+    // holds its tag, size, dispatch table and value.
+    Temporary temporary = context.allocTemporary(false);
+    context.emit_store(temporary, registers::a0);
+    allocate(context, Symbol::Int, 4);
+    context.emit_sw(context.emit_load(temporary, registers::t1), registers::a0, 12);
+    context.freeTemporary(temporary);
+  }
+}
+
+/**
+ * Generate `expr` whose value is discarded, without boxing it.
+ */
+static void cgenEffect(
+  const Expression *expr,
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) {
+  if (isValueType(expr->getStaticType())) {
+    expr->cgenValue(context, inheritanceTree, program, currentType, env);
+  }
+  else {
+    expr->cgen(context, inheritanceTree, program, currentType, env);
+  }
+}
+
+void Expression::cgenValue(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  cgen(context, inheritanceTree, program, currentType, env);
+  context.emit_lw(registers::a0, registers::a0, 12);
+}
+
+void Expression::cgenBranch(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env,
+  bool jumpIf,
+  unsigned int label) const {
+  cgenValue(context, inheritanceTree, program, currentType, env);
+  if (jumpIf) {
+    context.emit_bne(registers::a0, registers::zero, label);
+  }
+  else {
+    context.emit_beq(registers::a0, registers::zero, label);
+  }
+}
+
+void Assign::countUses(RepresentationContext &context, bool value) const {
+  expr->countUses(context, context.isCandidate(left));
+  context.assign(left, expr);
+}
+
+void Dispatch::countUses(RepresentationContext &context, bool value) const {
+  for (Expression *arg : args) {
+    arg->countUses(context, false);
+  }
+  if (expr) {
+    expr->countUses(context, false);
+  }
+}
+
+void Conditional::countUses(RepresentationContext &context, bool value) const {
+  pred->countUses(context, true);
+  then->countUses(context, value);
+  elSe->countUses(context, value);
+}
+
+void Loop::countUses(RepresentationContext &context, bool value) const {
+  context.enterLoop();
+  pred->countUses(context, true);
+  body->countUses(context, isValueType(body->getStaticType()));
+  context.leaveLoop();
+}
+
+void Block::countUses(RepresentationContext &context, bool value) const {
+  for (size_t i = 0, n = exprs.size(); i + 1 < n; i++) {
+    exprs[i]->countUses(context, isValueType(exprs[i]->getStaticType()));
+  }
+  exprs.back()->countUses(context, value);
+}
+
+void Definition::countUses(RepresentationContext &context) const {
+  if (init) {
+    init->countUses(context, isValueType(type));
+  }
+  context.define(name, this);
+  context.assign(name, init);
+}
+
+void Let::countUses(RepresentationContext &context, bool value) const {
+  context.enterScope();
+  for (Definition *def : defs) {
+    def->countUses(context);
+  }
+  body->countUses(context, value);
+  context.leaveScope();
+}
+
+void Branch::countUses(RepresentationContext &context) const {
+  context.enterScope();
+  context.define(name, nullptr);
+  expr->countUses(context, false);
+  context.leaveScope();
+}
+
+void Case::countUses(RepresentationContext &context, bool value) const {
+  expr->countUses(context, false);
+  for (Branch *branch : branches) {
+    branch->countUses(context);
+  }
+}
+
+void New::countUses(RepresentationContext &context, bool value) const {}
+
+void IsVoid::countUses(RepresentationContext &context, bool value) const {
+  expr->countUses(context, isValueType(expr->getStaticType()));
+}
+
+void Arithmetic::countUses(RepresentationContext &context, bool value) const {
+  std::vector<const Arithmetic *> nodes = spine();
+  nodes.back()->op1->countUses(context, true);
+  for (const Arithmetic *node : nodes) {
+    node->op2->countUses(context, true);
+  }
+}
+
+void Complement::countUses(RepresentationContext &context, bool value) const {
+  expr->countUses(context, true);
+}
+
+void Comparison::countUses(RepresentationContext &context, bool value) const {
+  bool values = comparesValues();
+  op1->countUses(context, values);
+  op2->countUses(context, values);
+}
+
+void Not::countUses(RepresentationContext &context, bool value) const {
+  expr->countUses(context, true);
+}
+
+void Object::countUses(RepresentationContext &context, bool value) const {
+  context.use(name, value);
+}
+
+void Integer::countUses(RepresentationContext &context, bool value) const {}
+
+void String::countUses(RepresentationContext &context, bool value) const {}
+
+void Boolean::countUses(RepresentationContext &context, bool value) const {}
+
+unsigned int Assign::cost(void) const {
+  return 1 + expr->cost();
+}
+
+unsigned int Dispatch::cost(void) const {
+  unsigned int n = 1 + (expr ? expr->cost() : 0);
+  for (Expression *arg : args) {
+    n += arg->cost();
+  }
+  return n;
+}
+
+unsigned int Conditional::cost(void) const {
+  return 1 + pred->cost() + then->cost() + elSe->cost();
+}
+
+unsigned int Loop::cost(void) const {
+  return 1 + pred->cost() + body->cost();
+}
+
+unsigned int Block::cost(void) const {
+  unsigned int n = 1;
+  for (Expression *expr : exprs) {
+    n += expr->cost();
+  }
+  return n;
+}
+
+unsigned int Definition::cost(void) const {
+  return 1 + (init ? init->cost() : 0);
+}
+
+unsigned int Let::cost(void) const {
+  unsigned int n = 1 + body->cost();
+  for (Definition *def : defs) {
+    n += def->cost();
+  }
+  return n;
+}
+
+unsigned int Branch::cost(void) const {
+  return 1 + expr->cost();
+}
+
+unsigned int Case::cost(void) const {
+  unsigned int n = 1 + expr->cost();
+  for (Branch *branch : branches) {
+    n += branch->cost();
+  }
+  return n;
+}
+
+unsigned int New::cost(void) const {
+  return 1;
+}
+
+unsigned int IsVoid::cost(void) const {
+  return 1 + expr->cost();
+}
+
+unsigned int Arithmetic::cost(void) const {
+  std::vector<const Arithmetic *> nodes = spine();
+  unsigned int n = nodes.back()->op1->cost();
+  for (const Arithmetic *node : nodes) {
+    n += 1 + node->op2->cost();
+  }
+  return n;
+}
+
+unsigned int Complement::cost(void) const {
+  return 1 + expr->cost();
+}
+
+unsigned int Comparison::cost(void) const {
+  return 1 + op1->cost() + op2->cost();
+}
+
+unsigned int Not::cost(void) const {
+  return 1 + expr->cost();
+}
+
+unsigned int Object::cost(void) const {
+  return 1;
+}
+
+unsigned int Integer::cost(void) const {
+  return 1;
+}
+
+unsigned int String::cost(void) const {
+  return 1;
+}
+
+unsigned int Boolean::cost(void) const {
+  return 1;
+}
+
+void Dispatch::findTailCalls(std::unordered_set<const Dispatch *> &calls) const {
+  calls.insert(this);
+}
+
+void Conditional::findTailCalls(std::unordered_set<const Dispatch *> &calls) const {
+  then->findTailCalls(calls);
+  elSe->findTailCalls(calls);
+}
+
+void Block::findTailCalls(std::unordered_set<const Dispatch *> &calls) const {
+  exprs.back()->findTailCalls(calls);
+}
+
+void Let::findTailCalls(std::unordered_set<const Dispatch *> &calls) const {
+  body->findTailCalls(calls);
+}
+
+void Branch::findTailCalls(std::unordered_set<const Dispatch *> &calls) const {
+  expr->findTailCalls(calls);
+}
+
+void Case::findTailCalls(std::unordered_set<const Dispatch *> &calls) const {
+  for (Branch *branch : branches) {
+    branch->findTailCalls(calls);
+  }
+}
+
+int Dispatch::frequency(const InheritanceTree &inheritanceTree, Symbol *currentType) const {
+  // Only a call that can reach no other method than Object.abort is cold
+  Symbol *dispatchType = expr ? expr->getStaticType() : currentType;
+  if (dispatchType == Symbol::SELF_TYPE) {
+    dispatchType = currentType;
+  }
+  const MethodInfo *methodInfo = type ?
+    inheritanceTree.getMethodInfo(type, name) :
+    inheritanceTree.getUniqueMethodInfo(dispatchType, name);
+  return methodInfo && methodInfo == inheritanceTree.getMethodInfo(Symbol::Object, Symbol::abort) ? -1 : 0;
+}
+
+int Loop::frequency(const InheritanceTree &inheritanceTree, Symbol *currentType) const {
+  return 1;
+}
+
+int Block::frequency(const InheritanceTree &inheritanceTree, Symbol *currentType) const {
+  int frequency = 0;
+  for (Expression *expr : exprs) {
+    int value = expr->frequency(inheritanceTree, currentType);
+    if (value < 0) {
+      return value;
+    }
+    frequency = std::max(frequency, value);
+  }
+  return frequency;
+}
+
+int Let::frequency(const InheritanceTree &inheritanceTree, Symbol *currentType) const {
+  return body->frequency(inheritanceTree, currentType);
+}
+
+/**
+ * Call the method at `label`, or jump to it for a tail call.
+ */
+static void callLabel(CGenContext &context, GlobalLabel label, bool tail) {
+  if (tail) {
+    context.emit_j(label);
+  }
+  else {
+    context.emit_jal(label);
+  }
+}
+
+/**
+ * Call `methodInfo` on the receiver in $a0 through its dispatch table.
+ * @param tail whether to jump to the method instead, see `callLabel`.
+ */
+static void callThroughTable(CGenContext &context, const MethodInfo *methodInfo, bool tail) {
+  context.emit_lw(registers::t1, registers::a0, 8);
+  context.emit_lw(registers::t1, registers::t1, methodInfo->index * 4);
+  if (tail) {
+    context.emit_jr(registers::t1);
+  }
+  else {
+    context.emit_jalr(registers::t1);
+  }
+}
+
+/**
+ * @brief Call `methodInfo` on the receiver in $a0 through an inline cache
+ * over its class tag.
+ *
+ * `targets` are the methods the receiver may dispatch to by ranges of tags,
+ * see `InheritanceTree::getDispatchTargets`. The first and last ranges are
+ * each told apart with a single comparison and called directly, the ones in
+ * between, if any, go through the dispatch table.
+ *
+ * @param tail whether to jump to the methods instead, see `callLabel`.
+ */
+static void callThroughCache(
+  CGenContext &context,
+  const std::vector<std::pair<unsigned int, const MethodInfo *>> &targets,
+  const MethodInfo *methodInfo,
+  bool tail) {
+  unsigned int first = context.newLabel();
+  unsigned int last = context.newLabel();
+  unsigned int done = context.newLabel();
+  Symbol *methName = methodInfo->methName;
+
+  context.emit_lw(registers::t1, registers::a0, 0); // Class tag
+  loadImmediate(context, registers::t2, targets[1].first);
+  context.emit_blt(registers::t1, registers::t2, first);
+  if (targets.size() > 2) {
+    loadImmediate(context, registers::t2, targets.back().first);
+    context.emit_bge(registers::t1, registers::t2, last);
+    callThroughTable(context, methodInfo, tail);
+    if (!tail) {
+      context.emit_j(done);
+    }
+  }
+
+  context.emit_label(last);
+  callLabel(context, context.getMethodLabel(targets.back().second->typeName, methName), tail);
+  if (!tail) {
+    context.emit_j(done);
+  }
+
+  context.emit_label(first);
+  callLabel(context, context.getMethodLabel(targets.front().second->typeName, methName), tail);
+
+  context.emit_label(done);
+}
+
+void Assign::cgen(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  if (env.isUnboxed(left)) {
+    cgenValue(context, inheritanceTree, program, currentType, env);
+    boxValue(context, expr->getStaticType());
+    return;
+  }
+
+  expr->cgen(context, inheritanceTree, program, currentType, env);
+
+  int frameOffset;
+  if (env.getFrameOffset(left, frameOffset)) {
+    context.emit_sw(registers::a0, registers::fp, frameOffset);
+  }
+  else if (const AttributeInfo *attributeInfo = inheritanceTree.getAttributeInfo(currentType, left)) {
+    context.emit_sw(registers::a0, registers::s0, 12 + attributeInfo->wordOffset * 4);
+  }
+  else {
+    assert(false);
+  }
+}
+
+void Assign::cgenValue(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  int frameOffset;
+  if (env.isUnboxed(left) && env.getFrameOffset(left, frameOffset)) {
+    expr->cgenValue(context, inheritanceTree, program, currentType, env);
+    context.emit_sw(registers::a0, registers::fp, frameOffset);
+  }
+  else {
+    Expression::cgenValue(context, inheritanceTree, program, currentType, env);
+  }
+}
+
+/**
+ * Runtime error check: dispatch on void, of the receiver in $a0.
+ */
+static void checkReceiver(CGenContext &context, const Program *program, const Dispatch *dispatch) {
+  context.emit_void_check("_dispatch_abort", "_dispatch_void", context.getConstantLabel(program->getName()), program->getLine(dispatch));
+}
+
+void Dispatch::cgen(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  Symbol *dispatchType = expr ? expr->getStaticType() : currentType;
+  if (dispatchType == Symbol::SELF_TYPE) {
+    dispatchType = currentType;
+  }
+
+  // Statically known target of the call, if any. Class hierarchy analysis:
+  // the receiver conforms to its static type, so a dynamic dispatch has a
+  // single target if no derived class overrides the method, or if only the
+  // classes inheriting one definition are instantiated.
+  const MethodInfo *methodInfo = nullptr;
+  std::vector<std::pair<unsigned int, const MethodInfo *>> targets;
+  DispatchStats &stats = context.getDispatchStats();
+  if (type) {
+    methodInfo = inheritanceTree.getMethodInfo(type, name);
+  }
+  else {
+    stats.sites++;
+    if (context.isOptimizing()) {
+      methodInfo = inheritanceTree.getUniqueMethodInfo(dispatchType, name);
+      if (!methodInfo) {
+        targets = inheritanceTree.getDispatchTargets(dispatchType, name, context.getInstantiatedClasses());
+        if (targets.size() == 1) {
+          methodInfo = targets.front().second;
+        }
+      }
+
+      if (methodInfo) {
+        stats.devirtualized++;
+      }
+      else if (targets.size() > 1) {
+        stats.cached++;
+      }
+    }
+  }
+
+  // A target that is never reached can only be called on void, the call
+  // goes through the dispatch table after the check.
+  if (methodInfo && !context.isReachable(methodInfo)) {
+    methodInfo = nullptr;
+    targets.clear();
+  }
+
+  if (methodInfo && context.canInline(methodInfo)) {
+    cgenInline(context, inheritanceTree, program, currentType, env, methodInfo);
+    return;
+  }
+
+  // The stack space of all the arguments is reserved at once, the first
+  // argument is the farthest from the top of the stack.
+  int argc = static_cast<int>(args.size());
+  if (argc > 0) {
+    context.emit_addiu(registers::sp, registers::sp, -4 * argc);
+  }
+  for (int i = 0; i < argc; i++) {
+    args[i]->cgen(context, inheritanceTree, program, currentType, env);
+    context.emit_sw(registers::a0, registers::sp, 4 * (argc - i));
+  }
+
+  if (expr) {
+    expr->cgen(context, inheritanceTree, program, currentType, env);
+  }
+  else {
+    context.emit_move(registers::a0, registers::s0);
+  }
+  if (context.needsVoidCheck(this)) {
+    checkReceiver(context, program, this);
+  }
+
+  // A call in tail position returns straight to the caller of this method.
+  // A method calling itself loops back to the start of its body instead.
+  bool tail = context.canTailCall(this, args.size());
+  if (tail) {
+    stats.tailCalls++;
+    if (context.isCurrentMethod(methodInfo)) {
+      context.emit_self_tail_call(static_cast<unsigned int>(argc));
+      return;
+    }
+    context.emit_tail_epilogue(static_cast<unsigned int>(argc));
+  }
+
+  if (methodInfo) {
+    callLabel(context, context.getMethodLabel(methodInfo->typeName, name), tail);
+  }
+  else if (targets.size() > 1) {
+    callThroughCache(context, targets, inheritanceTree.getMethodInfo(dispatchType, name), tail);
+  }
+  else {
+    callThroughTable(context, inheritanceTree.getMethodInfo(dispatchType, name), tail);
+  }
+}
+
+void Dispatch::cgenInline(
   CGenContext &context,
   const InheritanceTree &inheritanceTree,
   const Program *program,
   Symbol *currentType,
   Environment &env,
-  unsigned int esac_label) const {
+  const MethodInfo *methodInfo) const {
+  std::vector<Symbol *> params;
+  for (auto &paramDecl : methodInfo->methType.paramDecls) {
+    params.push_back(paramDecl.first);
+  }
+
+  // The self object of the caller, the arguments and the local variables of
+  // the method take frame slots of the caller, in this order.
+  unsigned int slots = 1 + static_cast<unsigned int>(params.size()) + methodInfo->locals;
+  int selfOffset = context.allocFrameSlots(slots);
+  Environment inlineEnv(params, selfOffset - 4);
+
+  for (size_t i = 0; i < args.size(); i++) {
+    args[i]->cgen(context, inheritanceTree, program, currentType, env);
+    context.emit_sw(registers::a0, registers::fp, selfOffset - 4 * static_cast<int>(i + 1));
+  }
+
+  // The body runs with the receiver as self
+  if (expr) {
+    expr->cgen(context, inheritanceTree, program, currentType, env);
+    if (context.needsVoidCheck(this)) {
+      checkReceiver(context, program, this);
+    }
+    context.emit_sw(registers::s0, registers::fp, selfOffset);
+    context.emit_move(registers::s0, registers::a0);
+  }
+
+  context.enterInline(methodInfo, context.isTailCall(this));
+  context.chooseRepresentations({ methodInfo->expr });
+  context.findUnchecked({ methodInfo->expr });
+  methodInfo->expr->cgen(
+    context,
+    inheritanceTree,
+    context.getProgram(methodInfo->typeName),
+    methodInfo->typeName,
+    inlineEnv);
+  context.leaveInline();
+
+  if (expr) {
+    context.emit_lw(registers::s0, registers::fp, selfOffset);
+  }
+  context.freeFrameSlots(slots);
+}
+
+void Conditional::cgen(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  cgenAs(false, context, inheritanceTree, program, currentType, env);
+}
+
+void Conditional::cgenValue(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  cgenAs(true, context, inheritanceTree, program, currentType, env);
+}
+
+void Conditional::cgenAs(
+  bool value,
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  unsigned int second_branch = context.newLabel();
+  unsigned int end_if = context.newLabel();
+
+  // With optimizations, the arm expected to run more often falls through the
+  // test, and the other one follows it
+  bool elseFirst = context.isOptimizing() &&
+    elSe->frequency(inheritanceTree, currentType) > then->frequency(inheritanceTree, currentType);
+  auto cgenArm = [&] (const Expression *expr) {
+    if (value) {
+      expr->cgenValue(context, inheritanceTree, program, currentType, env);
+    }
+    else {
+      expr->cgen(context, inheritanceTree, program, currentType, env);
+    }
+  };
+
+  pred->cgenBranch(context, inheritanceTree, program, currentType, env, elseFirst, second_branch);
+  cgenArm(elseFirst ? elSe : then);
+  context.emit_j(end_if);
+  context.emit_label(second_branch);
+  cgenArm(elseFirst ? then : elSe);
+  context.emit_label(end_if);
+}
+
+void Loop::cgen(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  unsigned int repeat = context.newLabel();
+
+  if (context.isOptimizing()) {
+    // The test is rotated to the bottom of the loop, where it branches back
+    // to the body, so that an iteration takes a single branch. The loop is
+    // entered with a jump to the test.
+    unsigned int test = context.newLabel();
+    context.emit_j(test);
+    context.emit_label(repeat);
+    cgenEffect(body, context, inheritanceTree, program, currentType, env);
+    context.emit_label(test);
+    pred->cgenBranch(context, inheritanceTree, program, currentType, env, true, repeat);
+  }
+  else {
+    unsigned int end_loop = context.newLabel();
+    context.emit_label(repeat);
+    pred->cgenBranch(context, inheritanceTree, program, currentType, env, false, end_loop);
+    cgenEffect(body, context, inheritanceTree, program, currentType, env);
+    context.emit_j(repeat);
+    context.emit_label(end_loop);
+  }
+  context.emit_move(registers::a0, registers::zero);
+}
+
+void Block::cgen(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  for (size_t i = 0, n = exprs.size(); i + 1 < n; i++) {
+    cgenEffect(exprs[i], context, inheritanceTree, program, currentType, env);
+  }
+  exprs.back()->cgen(context, inheritanceTree, program, currentType, env);
+}
+
+void Block::cgenValue(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  for (size_t i = 0, n = exprs.size(); i + 1 < n; i++) {
+    cgenEffect(exprs[i], context, inheritanceTree, program, currentType, env);
+  }
+  exprs.back()->cgenValue(context, inheritanceTree, program, currentType, env);
+}
+
+void Definition::cgen(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  bool unboxed = context.isUnboxed(this);
+  if (init && unboxed) {
+    init->cgenValue(context, inheritanceTree, program, currentType, env);
+  }
+  else if (init) {
+    init->cgen(context, inheritanceTree, program, currentType, env);
+  }
+  else if (unboxed) {
+    // 0 or false
+    context.emit_move(registers::a0, registers::zero);
+  }
+  else if (type == Symbol::Int) {
+    context.emit_la(registers::a0, context.getConstantLabel(0));
+  }
+  else if (type == Symbol::Bool) {
+    context.emit_la(registers::a0, context.getLabel("bool_const0"));
+  }
+  else if (type == Symbol::String) {
+    context.emit_la(registers::a0, context.getConstantLabel(""));
+  }
+  else {
+    context.emit_move(registers::a0, registers::zero);
+  }
+  int frameOffset = env.alloc(name, unboxed);
+  context.emit_sw(registers::a0, registers::fp, frameOffset);
+}
+
+void Let::cgen(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  EnvironmentGuard eg(env);
+
+  for (Definition *def : defs) {
+    def->cgen(context, inheritanceTree, program, currentType, env);
+  }
+  body->cgen(context, inheritanceTree, program, currentType, env);
+}
+
+void Let::cgenValue(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  EnvironmentGuard eg(env);
+
+  for (Definition *def : defs) {
+    def->cgen(context, inheritanceTree, program, currentType, env);
+  }
+  body->cgenValue(context, inheritanceTree, program, currentType, env);
+}
+
+void Branch::cgen(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
   EnvironmentGuard eg(env);
 
-  int next_label = context.newLabel();
-  const ClassInfo *classInfo = inheritanceTree.getClassInfo(type);
+  int frameOffset = env.alloc(name);
+  context.emit_sw(registers::a0, registers::fp, frameOffset);
+  expr->cgen(context, inheritanceTree, program, currentType, env);
+}
+
+/**
+ * @brief Jump to the label of the run of `runs` holding the class tag in $t1,
+ * by binary search over the first tags of [`first`, `last`).
+ */
+static void jumpByTag(
+  CGenContext &context,
+  const std::vector<std::pair<unsigned int, size_t>> &runs,
+  const std::vector<unsigned int> &labels,
+  size_t first,
+  size_t last) {
+  if (last - first == 1) {
+    context.emit_j(labels[runs[first].second]);
+    return;
+  }
+
+  size_t middle = first + (last - first) / 2;
+  unsigned int upper = context.newLabel();
+  loadImmediate(context, registers::t2, runs[middle].first);
+  context.emit_bge(registers::t1, registers::t2, upper);
+  jumpByTag(context, runs, labels, first, middle);
+  context.emit_label(upper);
+  jumpByTag(context, runs, labels, middle, last);
+}
+
+void Case::cgen(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  static const size_t JUMP_TABLE_RUNS = 4;    // Fewer runs take at most two comparisons
+  static const size_t JUMP_TABLE_DENSITY = 4; // Maximum entries per run
+
+  unsigned int esac_label = context.newLabel();
+
+  expr->cgen(context, inheritanceTree, program, currentType, env);
+
+  // Runtime error check: case on void
+  if (context.needsVoidCheck(this)) {
+    context.emit_void_check("_case_abort2", "_case_void", context.getConstantLabel(program->getName()), program->getLine(this));
+  }
+
+  // Only the classes conforming to the static type of the expression can
+  // occur. Each one selects the branch of its nearest ancestor, found by
+  // marking the tags of the branches from the outermost to the innermost.
+  Symbol *exprType = expr->getStaticType();
+  if (exprType == Symbol::SELF_TYPE) {
+    exprType = currentType;
+  }
+  const ClassInfo *exprInfo = inheritanceTree.getClassInfo(exprType);
+  size_t none = branches.size(); // No matching branch
+
+  std::vector<std::pair<unsigned int, size_t>> sortedBranches;
+  for (size_t i = 0; i < branches.size(); i++) {
+    sortedBranches.push_back({ inheritanceTree.getClassInfo(branches[i]->getType())->tag, i });
+  }
+  std::sort(sortedBranches.begin(), sortedBranches.end());
+
+  std::vector<size_t> selected(exprInfo->tagEnd - exprInfo->tag, none);
+  for (auto &item : sortedBranches) {
+    const ClassInfo *classInfo = inheritanceTree.getClassInfo(branches[item.second]->getType());
+    unsigned int first = std::max(classInfo->tag, exprInfo->tag);
+    unsigned int last = std::min(classInfo->tagEnd, exprInfo->tagEnd);
+    for (unsigned int tag = first; tag < last; tag++) {
+      selected[tag - exprInfo->tag] = item.second;
+    }
+  }
+
+  // (first tag, branch) runs of consecutive tags selecting the same branch
+  std::vector<std::pair<unsigned int, size_t>> runs;
+  for (unsigned int tag = exprInfo->tag; tag < exprInfo->tagEnd; tag++) {
+    size_t branch = selected[tag - exprInfo->tag];
+    if (runs.empty() || runs.back().second != branch) {
+      runs.push_back({ tag, branch });
+    }
+  }
+
+  std::vector<bool> used(branches.size() + 1, false);
+  for (auto &run : runs) {
+    used[run.second] = true;
+  }
+  std::vector<unsigned int> labels;
+  for (size_t i = 0; i <= branches.size(); i++) {
+    labels.push_back(context.newLabel());
+  }
+
+  bool optimize = context.isOptimizing();
+  std::vector<GlobalLabel> codeLabels;
+  if (optimize && runs.size() >= JUMP_TABLE_RUNS && selected.size() <= JUMP_TABLE_DENSITY * runs.size()) {
+    for (size_t i = 0; i <= branches.size(); i++) {
+      codeLabels.push_back(used[i] ? context.newCodeLabel() : GlobalLabel::none);
+    }
+    std::vector<GlobalLabel> targets;
+    for (size_t branch : selected) {
+      targets.push_back(codeLabels[branch]);
+    }
+
+    // The table starts at the first tag conforming to the static type
+    context.emit_lw(registers::t1, registers::a0, 0); // Class tag
+    context.emit_la(registers::t2, context.newJumpTable(targets));
+    context.emit_sll(registers::t1, registers::t1, 2);
+    context.emit_addu(registers::t2, registers::t2, registers::t1);
+    context.emit_lw(registers::t2, registers::t2, -4 * static_cast<int>(exprInfo->tag));
+    context.emit_jr(registers::t2);
+  }
+  else if (!optimize || runs.size() > 1) {
+    context.emit_lw(registers::t1, registers::a0, 0); // Class tag
+    jumpByTag(context, runs, labels, 0, runs.size());
+  }
+  // Otherwise the static type fixes the branch, which follows
+
+  if (used[none]) {
+    // Runtime error check: missing branch
+    context.emit_label(labels[none]);
+    if (!codeLabels.empty()) {
+      context.emit_code_label(codeLabels[none]);
+    }
+    context.emit_jal(context.getLabel("_case_abort"));
+  }
+
+  for (size_t i = 0; i < branches.size(); i++) {
+    if (!used[i]) {
+      continue;
+    }
+    context.emit_label(labels[i]);
+    if (!codeLabels.empty()) {
+      context.emit_code_label(codeLabels[i]);
+    }
+    branches[i]->cgen(context, inheritanceTree, program, currentType, env);
+    context.emit_j(esac_label);
+  }
+
+  context.emit_label(esac_label);
+}
+
+void New::cgen(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  if (type == Symbol::SELF_TYPE) {
+    context.emit_la(registers::t1, context.getLabel("class_objTab"));
+    context.emit_lw(registers::t2, registers::s0, 0);
+    context.emit_sll(registers::t2, registers::t2, 3);
+    context.emit_addu(registers::t1, registers::t1, registers::t2);
+    context.emit_lw(registers::a0, registers::t1, 0); // <Class>_protObj
+    context.emit_sw(registers::t1, registers::sp, 0);
+    context.emit_addiu(registers::sp, registers::sp, -4);
+    context.emit_jal(context.getLabel("Object.copy"));
+    context.emit_addiu(registers::sp, registers::sp, 4);
+    context.emit_lw(registers::t1, registers::sp, 0);
+    context.emit_lw(registers::t1, registers::t1, 4); // <Class>_init
+    context.emit_jalr(registers::t1);
+  }
+  else {
+    const ClassInfo *classInfo = inheritanceTree.getClassInfo(type);
+    allocate(context, type, 3 + classInfo->wordSize);
+
+    // The prototype already holds the attributes that need no initializer to
+    // run, there may be nothing left to initialize
+    if (needsInit(context, classInfo)) {
+      context.emit_jal(context.getInitLabel(type));
+    }
+  }
+}
+
+void IsVoid::cgen(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  cgenValue(context, inheritanceTree, program, currentType, env);
+  boxValue(context, Symbol::Bool);
+}
+
+void IsVoid::cgenValue(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  if (isValueType(expr->getStaticType())) {
+    // Int and Bool objects are never void
+    expr->cgenValue(context, inheritanceTree, program, currentType, env);
+    context.emit_move(registers::a0, registers::zero);
+  }
+  else {
+    expr->cgen(context, inheritanceTree, program, currentType, env);
+    context.emit_sltiu(registers::a0, registers::a0, 1);
+  }
+}
+
+void IsVoid::cgenBranch(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env,
+  bool jumpIf,
+  unsigned int label) const {
+  if (isValueType(expr->getStaticType())) {
+    expr->cgenValue(context, inheritanceTree, program, currentType, env);
+    if (!jumpIf) {
+      context.emit_j(label);
+    }
+  }
+  else {
+    expr->cgen(context, inheritanceTree, program, currentType, env);
+    if (jumpIf) {
+      context.emit_beq(registers::a0, registers::zero, label);
+    }
+    else {
+      context.emit_bne(registers::a0, registers::zero, label);
+    }
+  }
+}
+
+/**
+ * @return whether the second operand of a binary operation should be evaluated
+ * first, which is the case when it needs more temporaries and the order of
+ * evaluation is not observable.
+ */
+static bool evaluateSecondFirst(const Expression *op1, const Expression *op2) {
+  return op2->temporaries() > op1->temporaries() && op1->isPure() && op2->isPure();
+}
 
-  int frameOffset = env.alloc(name);
-  context.emit_sw(registers::a0, registers::fp, frameOffset);
+/**
+ * @return the Sethi-Ullman number of a binary operation: the value of the
+ * operand evaluated first is held in a temporary while the other one is
+ * evaluated.
+ */
+static unsigned int binaryTemporaries(const Expression *op1, const Expression *op2) {
+  unsigned int need1 = op1->temporaries();
+  unsigned int need2 = op2->temporaries();
+  if (evaluateSecondFirst(op1, op2)) {
+    return std::max(need2, need1 + 1);
+  }
+  return std::max(need1, need2 + 1);
+}
 
-  context.emit_li(registers::t2, classInfo->tag);
-  context.emit_blt(registers::t1, registers::t2, next_label);
-  context.emit_li(registers::t2, classInfo->tagEnd);
-  context.emit_bge(registers::t1, registers::t2, next_label);
-  expr->cgen(context, inheritanceTree, program, currentType, env);
-  context.emit_j(esac_label);
+/**
+ * Hold the raw value in $a0 in a new temporary.
+ */
+static Temporary holdValue(CGenContext &context, bool acrossCalls) {
+  Temporary temporary = context.allocTemporary(acrossCalls);
+  context.emit_store(temporary, registers::a0);
+  return temporary;
+}
 
-  context.emit_label(next_label);
+/**
+ * @return the integer literal `expr`, an operand that the optimized code
+ * applies as an immediate, or `nullptr`.
+ */
+static const Integer *constantOperand(const CGenContext &context, const Expression *expr) {
+  return context.isOptimizing() ? dynamic_cast<const Integer *>(expr) : nullptr;
 }
 
-void Case::cgen(
-  CGenContext &context,
-  const InheritanceTree &inheritanceTree,
-  const Program *program,
-  Symbol *currentType,
-  Environment &env) const {
-  unsigned int case_label = context.newLabel();
-  unsigned int esac_label = context.newLabel();
+/**
+ * @return `log2(value)` if `value` is a power of two, or -1.
+ */
+static int exactLog2(unsigned int value) {
+  if (value == 0 || (value & (value - 1)) != 0) {
+    return -1;
+  }
+  int log = 0;
+  while (value >>= 1) {
+    log++;
+  }
+  return log;
+}
 
-  expr->cgen(context, inheritanceTree, program, currentType, env);
+/**
+ * @brief Compute the magic multiplier and shift of the signed division by
+ * `divisor`, from *Hacker's Delight*, 10-4: the quotient is the high word of
+ * the product by `multiplier`, corrected by the dividend when the multiplier
+ * overflowed, shifted right by `shift` and rounded toward zero.
+ *
+ * The divisor must not be 0, 1, -1, nor INT_MIN.
+ */
+static void divisionMagic(int divisor, int &multiplier, int &shift) {
+  const unsigned int two31 = 0x80000000u;
+  unsigned int ad = divisor < 0 ? 0u - static_cast<unsigned int>(divisor) : static_cast<unsigned int>(divisor);
+  unsigned int t = two31 + (static_cast<unsigned int>(divisor) >> 31);
+  unsigned int anc = t - 1 - t % ad;
+  unsigned int q1 = two31 / anc;
+  unsigned int r1 = two31 - q1 * anc;
+  unsigned int q2 = two31 / ad;
+  unsigned int r2 = two31 - q2 * ad;
+  unsigned int delta;
+  int p = 31;
+  do {
+    p++;
+    q1 *= 2;
+    r1 *= 2;
+    if (r1 >= anc) {
+      q1++;
+      r1 -= anc;
+    }
+    q2 *= 2;
+    r2 *= 2;
+    if (r2 >= ad) {
+      q2++;
+      r2 -= ad;
+    }
+    delta = ad - r2;
+  } while (q1 < delta || (q1 == delta && r1 == 0));
 
-  // Runtime error check: case on void
-  context.emit_bne(registers::a0, registers::zero, case_label);
-  context.emit_la(registers::a0, context.getConstantLabel(program->getName()));
-  context.emit_li(registers::t1, program->getLine(this));
-  context.emit_jal("_case_abort2");
+  unsigned int magic = q2 + 1;
+  multiplier = static_cast<int>(divisor < 0 ? 0u - magic : magic);
+  shift = p - 32;
+}
 
-  context.emit_label(case_label);
-  context.emit_lw(registers::t1, registers::a0, 0); // Class tag
+/**
+ * Multiply the raw value in $a0 by `value`, keeping the low word of the
+ * product like `mult`: powers of two and their neighbours are shifted.
+ */
+static void multiplyByConstant(CGenContext &context, int value) {
+  unsigned int magnitude = value < 0 ? 0u - static_cast<unsigned int>(value) : static_cast<unsigned int>(value);
+  int log = exactLog2(magnitude);
+  if (value == 0) {
+    context.emit_move(registers::a0, registers::zero);
+  }
+  else if (log >= 0) {
+    if (log > 0) {
+      context.emit_sll(registers::a0, registers::a0, static_cast<unsigned char>(log));
+    }
+    if (value < 0) {
+      context.emit_subu(registers::a0, registers::zero, registers::a0);
+    }
+  }
+  else if (value > 0 && exactLog2(magnitude - 1) > 0) {
+    context.emit_sll(registers::t1, registers::a0, static_cast<unsigned char>(exactLog2(magnitude - 1)));
+    context.emit_addu(registers::a0, registers::t1, registers::a0);
+  }
+  else if (value > 0 && exactLog2(magnitude + 1) > 0) {
+    context.emit_sll(registers::t1, registers::a0, static_cast<unsigned char>(exactLog2(magnitude + 1)));
+    context.emit_subu(registers::a0, registers::t1, registers::a0);
+  }
+  else {
+    loadImmediate(context, registers::t1, value);
+    context.emit_mult(registers::a0, registers::t1);
+    context.emit_mflo(registers::a0);
+  }
+}
 
-  std::vector<std::pair<unsigned int, Branch*>> sortedBranches;
-  for (Branch *branch : branches) {
-    sortedBranches.push_back({ inheritanceTree.getClassInfo(branch->getType())->tag, branch });
+/**
+ * Divide the raw value in $a0 by `value`, rounding toward zero like `div`.
+ * The division by 0 and the ones that may overflow, by -1 and INT_MIN, keep
+ * the `div` instruction and its runtime behaviour.
+ */
+static void divideByConstant(CGenContext &context, int value) {
+  unsigned int magnitude = value < 0 ? 0u - static_cast<unsigned int>(value) : static_cast<unsigned int>(value);
+  int log = exactLog2(magnitude);
+  if (value == 1) {
+    return;
+  }
+  if (value == 0 || value == -1 || value == INT_MIN) {
+    loadImmediate(context, registers::t1, value);
+    context.emit_div(registers::a0, registers::t1);
+    context.emit_mflo(registers::a0);
+    return;
   }
-  std::sort(sortedBranches.begin(), sortedBranches.end());
-  std::reverse(sortedBranches.begin(), sortedBranches.end());
 
-  for (auto &item : sortedBranches) {
-    item.second->cgen(context, inheritanceTree, program, currentType, env, esac_label);
+  if (log > 0) {
+    // Bias a negative dividend by `2^log - 1` so that the shift rounds
+    // toward zero
+    if (log == 1) {
+      context.emit_srl(registers::t1, registers::a0, 31);
+    }
+    else {
+      context.emit_sra(registers::t1, registers::a0, 31);
+      context.emit_srl(registers::t1, registers::t1, static_cast<unsigned char>(32 - log));
+    }
+    context.emit_addu(registers::t1, registers::a0, registers::t1);
+    context.emit_sra(registers::a0, registers::t1, static_cast<unsigned char>(log));
+    if (value < 0) {
+      context.emit_subu(registers::a0, registers::zero, registers::a0);
+    }
+    return;
   }
 
-  // Runtime error check: missing branch
-  context.emit_jal("_case_abort");
+  int multiplier;
+  int shift;
+  divisionMagic(value, multiplier, shift);
+  loadImmediate(context, registers::t1, multiplier);
+  context.emit_mult(registers::a0, registers::t1);
+  context.emit_mfhi(registers::t1);
+  if (value > 0 && multiplier < 0) {
+    context.emit_addu(registers::t1, registers::t1, registers::a0);
+  }
+  else if (value < 0 && multiplier > 0) {
+    context.emit_subu(registers::t1, registers::t1, registers::a0);
+  }
+  if (shift > 0) {
+    context.emit_sra(registers::t1, registers::t1, static_cast<unsigned char>(shift));
+  }
+  // Add one to a negative quotient
+  context.emit_srl(registers::t2, registers::t1, 31);
+  context.emit_addu(registers::a0, registers::t1, registers::t2);
+}
 
-  context.emit_label(esac_label);
+bool Arithmetic::callsMethod(void) const {
+  std::vector<const Arithmetic *> nodes = spine();
+  if (nodes.back()->op1->callsMethod()) {
+    return true;
+  }
+  for (const Arithmetic *node : nodes) {
+    if (node->op2->callsMethod()) {
+      return true;
+    }
+  }
+  return false;
 }
 
-void New::cgen(
-  CGenContext &context,
-  const InheritanceTree &inheritanceTree,
-  const Program *program,
-  Symbol *currentType,
-  Environment &env) const {
-  if (type == Symbol::SELF_TYPE) {
-    context.emit_la(registers::t1, "class_ObjTab");
-    context.emit_lw(registers::t2, registers::s0, 0);
-    context.emit_sll(registers::t2, registers::t2, 3);
-    context.emit_addu(registers::t1, registers::t1, registers::t2);
-    context.emit_lw(registers::a0, registers::t1, 0); // <Class>_protObj
-    context.emit_sw(registers::t1, registers::sp, 0);
-    context.emit_addiu(registers::sp, registers::sp, -4);
-    context.emit_jal("Object.copy");
-    context.emit_addiu(registers::sp, registers::sp, 4);
-    context.emit_lw(registers::t1, registers::sp, 0);
-    context.emit_lw(registers::t1, registers::t1, 4); // <Class>_init
-    context.emit_jalr(registers::t1);
+bool Arithmetic::isPure(void) const {
+  std::vector<const Arithmetic *> nodes = spine();
+  if (!nodes.back()->op1->isPure()) {
+    return false;
+  }
+  for (const Arithmetic *node : nodes) {
+    if (!node->op2->isPure()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+unsigned int Arithmetic::temporaries(void) const {
+  // A literal operand is an immediate, which needs no temporary
+  std::vector<const Arithmetic *> nodes = spine();
+  const Arithmetic *bottom = nodes.back();
+  unsigned int need;
+  if (dynamic_cast<const Integer *>(bottom->op1)) {
+    need = bottom->op2->temporaries();
+  }
+  else if (dynamic_cast<const Integer *>(bottom->op2)) {
+    need = bottom->op1->temporaries();
   }
   else {
-    context.emit_la(registers::a0, type->to_string() + "_protObj");
-    context.emit_jal("Object.copy");
-    context.emit_jal(type->to_string() + "_init");
+    need = binaryTemporaries(bottom->op1, bottom->op2);
+  }
+  for (auto iter = nodes.rbegin() + 1, last = nodes.rend(); iter != last; iter++) {
+    if (!dynamic_cast<const Integer *>((*iter)->op2)) {
+      need = std::max(need, (*iter)->op2->temporaries() + 1);
+    }
   }
+  return need;
 }
 
-void IsVoid::cgen(
+void Arithmetic::cgen(
   CGenContext &context,
   const InheritanceTree &inheritanceTree,
   const Program *program,
   Symbol *currentType,
   Environment &env) const {
-  unsigned int label = context.newLabel();
-
-  context.emit_move(registers::t1, registers::a0);
-  context.emit_la(registers::a0, "bool_const0");
-  context.emit_bne(registers::t1, registers::zero, label);
-  context.emit_la(registers::a0, "bool_const1");
-  context.emit_label(label);
+  cgenValue(context, inheritanceTree, program, currentType, env);
+  boxValue(context, Symbol::Int);
 }
 
-void Arithmetic::cgen(
+void Arithmetic::cgenValue(
   CGenContext &context,
   const InheritanceTree &inheritanceTree,
   const Program *program,
   Symbol *currentType,
   Environment &env) const {
-  op1->cgen(context, inheritanceTree, program, currentType, env);
-  context.emit_sw(registers::a0, registers::sp, 0);
-  context.emit_addiu(registers::sp, registers::sp, -4);
-  op2->cgen(context, inheritanceTree, program, currentType, env);
-  context.emit_jal("Object.copy");
-  context.emit_addiu(registers::sp, registers::sp, 4);
-  context.emit_lw(registers::t1, registers::sp, 0);
-  context.emit_lw(registers::t1, registers::t1, 12); // op1
-  context.emit_lw(registers::t2, registers::a0, 12); // op2
+  // A chain `a + b + c + ...` is generated bottom-up along its left spine, the
+  // accumulated value of the chain stays in $a0 between the operators, and the
+  // value of the left operand in a temporary while the right one is evaluated.
+  // With optimizations, the integer literals are applied as immediates.
+  std::vector<const Arithmetic *> nodes = spine();
+  const Arithmetic *bottom = nodes.back();
+  auto iter = nodes.rbegin();
+
+  if (const Integer *constant = constantOperand(context, bottom->op1)) {
+    bottom->op2->cgenValue(context, inheritanceTree, program, currentType, env);
+    bottom->cgenConstantOperation(context, constant->getValue(), true);
+    iter++;
+  }
+  else if (evaluateSecondFirst(bottom->op1, bottom->op2)) {
+    bottom->op2->cgenValue(context, inheritanceTree, program, currentType, env);
+    Temporary temporary = holdValue(context, bottom->op1->callsMethod());
+    bottom->op1->cgenValue(context, inheritanceTree, program, currentType, env);
+    bottom->cgenOperation(context, registers::a0, context.emit_load(temporary, registers::t2));
+    context.freeTemporary(temporary);
+    iter++;
+  }
+  else {
+    bottom->op1->cgenValue(context, inheritanceTree, program, currentType, env);
+  }
+
+  for (auto last = nodes.rend(); iter != last; iter++) {
+    const Arithmetic *node = *iter;
+    if (const Integer *constant = constantOperand(context, node->op2)) {
+      node->cgenConstantOperation(context, constant->getValue(), false);
+      continue;
+    }
+    Temporary temporary = holdValue(context, node->op2->callsMethod());
+    node->op2->cgenValue(context, inheritanceTree, program, currentType, env);
+    node->cgenOperation(context, context.emit_load(temporary, registers::t1), registers::a0);
+    context.freeTemporary(temporary);
+  }
+}
+
+void Arithmetic::cgenOperation(CGenContext &context, Reg lhs, Reg rhs) const {
+  switch (op) {
+    case ArithmeticOperator::ADD:
+      context.emit_add(registers::a0, lhs, rhs);
+      break;
+    case ArithmeticOperator::SUB:
+      context.emit_sub(registers::a0, lhs, rhs);
+      break;
+    case ArithmeticOperator::MUL:
+      context.emit_mult(lhs, rhs);
+      context.emit_mflo(registers::a0);
+      break;
+    case ArithmeticOperator::DIV:
+      context.emit_div(lhs, rhs);
+      context.emit_mflo(registers::a0);
+      break;
+    default:
+      assert(false);
+  }
+}
+
+void Arithmetic::cgenConstantOperation(CGenContext &context, int value, bool constantFirst) const {
   switch (op) {
     case ArithmeticOperator::ADD:
-      context.emit_add(registers::t1, registers::t1, registers::t2);
+      // `addi` traps on overflow like `add`
+      if (value == 0) {
+        break;
+      }
+      if (value >= SHRT_MIN && value <= SHRT_MAX) {
+        context.emit_addi(registers::a0, registers::a0, static_cast<short>(value));
+      }
+      else {
+        loadImmediate(context, registers::t1, value);
+        context.emit_add(registers::a0, registers::a0, registers::t1);
+      }
       break;
     case ArithmeticOperator::SUB:
-      context.emit_sub(registers::t1, registers::t1, registers::t2);
+      if (constantFirst) {
+        loadImmediate(context, registers::t1, value);
+        context.emit_sub(registers::a0, registers::t1, registers::a0);
+      }
+      else if (value == 0) {
+        break;
+      }
+      else if (value > SHRT_MIN && value <= -SHRT_MIN) {
+        context.emit_addi(registers::a0, registers::a0, static_cast<short>(-value));
+      }
+      else {
+        loadImmediate(context, registers::t1, value);
+        context.emit_sub(registers::a0, registers::a0, registers::t1);
+      }
       break;
     case ArithmeticOperator::MUL:
-      context.emit_mult(registers::t1, registers::t2);
-      context.emit_mflo(registers::t1);
+      multiplyByConstant(context, value);
       break;
     case ArithmeticOperator::DIV:
-      context.emit_div(registers::t1, registers::t2);
-      context.emit_mflo(registers::t1);
+      if (constantFirst) {
+        loadImmediate(context, registers::t1, value);
+        context.emit_div(registers::t1, registers::a0);
+        context.emit_mflo(registers::a0);
+      }
+      else {
+        divideByConstant(context, value);
+      }
       break;
     default:
       assert(false);
   }
-  context.emit_sw(registers::t1, registers::a0, 12);
 }
 
 void Complement::cgen(
@@ -685,11 +2570,35 @@ void Complement::cgen(
   const Program *program,
   Symbol *currentType,
   Environment &env) const {
-  expr->cgen(context, inheritanceTree, program, currentType, env);
-  context.emit_jal("Object.copy");
-  context.emit_lw(registers::t1, registers::a0, 12);
-  context.emit_sub(registers::t1, registers::zero, registers::t1);
-  context.emit_sw(registers::t1, registers::a0, 12);
+  cgenValue(context, inheritanceTree, program, currentType, env);
+  boxValue(context, Symbol::Int);
+}
+
+void Complement::cgenValue(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  expr->cgenValue(context, inheritanceTree, program, currentType, env);
+  context.emit_sub(registers::a0, registers::zero, registers::a0);
+}
+
+bool Comparison::callsMethod(void) const {
+  return op1->callsMethod() || op2->callsMethod();
+}
+
+bool Comparison::isPure(void) const {
+  return op1->isPure() && op2->isPure();
+}
+
+unsigned int Comparison::temporaries(void) const {
+  return binaryTemporaries(op1, op2);
+}
+
+bool Comparison::comparesValues(void) const {
+  return op != ComparisonOperator::EQ ||
+    (isValueType(op1->getStaticType()) && isValueType(op2->getStaticType()));
 }
 
 void Comparison::cgen(
@@ -698,31 +2607,137 @@ void Comparison::cgen(
   const Program *program,
   Symbol *currentType,
   Environment &env) const {
-  unsigned int label = context.newLabel();
+  cgenValue(context, inheritanceTree, program, currentType, env);
+  boxValue(context, Symbol::Bool);
+}
+
+void Comparison::cgenValue(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  if (!comparesValues()) {
+    cgenEquality(context, inheritanceTree, program, currentType, env);
+    return;
+  }
+
+  Reg lhs;
+  Reg rhs;
+  cgenOperands(context, inheritanceTree, program, currentType, env, lhs, rhs);
+
+  switch (op) {
+    case ComparisonOperator::LT:
+      context.emit_slt(registers::a0, lhs, rhs);
+      break;
+    case ComparisonOperator::LE:
+      context.emit_slt(registers::a0, rhs, lhs);
+      context.emit_xori(registers::a0, registers::a0, 1);
+      break;
+    case ComparisonOperator::EQ:
+      context.emit_xor(registers::a0, lhs, rhs);
+      context.emit_sltiu(registers::a0, registers::a0, 1);
+      break;
+    default:
+      assert(false);
+  }
+}
+
+void Comparison::cgenBranch(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env,
+  bool jumpIf,
+  unsigned int label) const {
+  if (!comparesValues()) {
+    Expression::cgenBranch(context, inheritanceTree, program, currentType, env, jumpIf, label);
+    return;
+  }
+
+  Reg lhs;
+  Reg rhs;
+  cgenOperands(context, inheritanceTree, program, currentType, env, lhs, rhs);
 
-  op1->cgen(context, inheritanceTree, program, currentType, env);
-  context.emit_sw(registers::a0, registers::sp, 0);
-  context.emit_addiu(registers::sp, registers::sp, -4);
-  op2->cgen(context, inheritanceTree, program, currentType, env);
-  context.emit_addiu(registers::sp, registers::sp, 4);
-  context.emit_lw(registers::t1, registers::sp, 0);
-  context.emit_lw(registers::t1, registers::t1, 12); // op1
-  context.emit_lw(registers::t2, registers::a0, 12); // op2
-  context.emit_la(registers::a0, "bool_const1");
   switch (op) {
     case ComparisonOperator::LT:
-      context.emit_blt(registers::t1, registers::t2, label);
+      if (jumpIf) {
+        context.emit_blt(lhs, rhs, label);
+      }
+      else {
+        context.emit_bge(lhs, rhs, label);
+      }
       break;
     case ComparisonOperator::LE:
-      context.emit_ble(registers::t1, registers::t2, label);
+      if (jumpIf) {
+        context.emit_ble(lhs, rhs, label);
+      }
+      else {
+        context.emit_bgt(lhs, rhs, label);
+      }
       break;
     case ComparisonOperator::EQ:
-      context.emit_beq(registers::t1, registers::t2, label);
+      if (jumpIf) {
+        context.emit_beq(lhs, rhs, label);
+      }
+      else {
+        context.emit_bne(lhs, rhs, label);
+      }
       break;
     default:
       assert(false);
   }
-  context.emit_la(registers::a0, "bool_const0");
+}
+
+void Comparison::cgenOperands(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env,
+  Reg &lhs,
+  Reg &rhs) const {
+  Temporary temporary;
+  if (evaluateSecondFirst(op1, op2)) {
+    op2->cgenValue(context, inheritanceTree, program, currentType, env);
+    temporary = holdValue(context, op1->callsMethod());
+    op1->cgenValue(context, inheritanceTree, program, currentType, env);
+    lhs = registers::a0;
+    rhs = context.emit_load(temporary, registers::t2);
+  }
+  else {
+    op1->cgenValue(context, inheritanceTree, program, currentType, env);
+    temporary = holdValue(context, op2->callsMethod());
+    op2->cgenValue(context, inheritanceTree, program, currentType, env);
+    lhs = context.emit_load(temporary, registers::t1);
+    rhs = registers::a0;
+  }
+  context.freeTemporary(temporary);
+}
+
+void Comparison::cgenEquality(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  unsigned int label = context.newLabel();
+
+  // The first object stays on the stack, where the garbage collector sees it,
+  // while the second one is evaluated.
+  op1->cgen(context, inheritanceTree, program, currentType, env);
+  context.emit_sw(registers::a0, registers::sp, 0);
+  context.emit_addiu(registers::sp, registers::sp, -4);
+  op2->cgen(context, inheritanceTree, program, currentType, env);
+  context.emit_move(registers::t2, registers::a0);
+  context.emit_addiu(registers::sp, registers::sp, 4);
+  context.emit_lw(registers::t1, registers::sp, 0);
+
+  context.emit_li(registers::a0, 1);
+  context.emit_beq(registers::t1, registers::t2, label);
+  context.emit_li(registers::a1, 0);
+  context.emit_jal(context.getLabel("equality_test"));
   context.emit_label(label);
 }
 
@@ -732,10 +2747,29 @@ void Not::cgen(
   const Program *program,
   Symbol *currentType,
   Environment &env) const {
-  context.emit_jal("Object.copy");
-  context.emit_lw(registers::t1, registers::a0, 12);
-  context.emit_nor(registers::t1, registers::t1, registers::t1);
-  context.emit_sw(registers::t1, registers::a0, 12);
+  cgenValue(context, inheritanceTree, program, currentType, env);
+  boxValue(context, Symbol::Bool);
+}
+
+void Not::cgenValue(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  expr->cgenValue(context, inheritanceTree, program, currentType, env);
+  context.emit_xori(registers::a0, registers::a0, 1);
+}
+
+void Not::cgenBranch(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env,
+  bool jumpIf,
+  unsigned int label) const {
+  expr->cgenBranch(context, inheritanceTree, program, currentType, env, !jumpIf, label);
 }
 
 void Object::cgen(
@@ -750,6 +2784,9 @@ void Object::cgen(
   }
   else if (env.getFrameOffset(name, frameOffset)) {
     context.emit_lw(registers::a0, registers::fp, frameOffset);
+    if (env.isUnboxed(name)) {
+      boxValue(context, getStaticType());
+    }
   }
   else if (const AttributeInfo *attributeInfo = inheritanceTree.getAttributeInfo(currentType, name)) {
     context.emit_lw(registers::a0, registers::s0, 12 + attributeInfo->wordOffset * 4);
@@ -759,6 +2796,21 @@ void Object::cgen(
   }
 }
 
+void Object::cgenValue(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  int frameOffset;
+  if (env.isUnboxed(name) && env.getFrameOffset(name, frameOffset)) {
+    context.emit_lw(registers::a0, registers::fp, frameOffset);
+  }
+  else {
+    Expression::cgenValue(context, inheritanceTree, program, currentType, env);
+  }
+}
+
 void Integer::cgen(
   CGenContext &context,
   const InheritanceTree &inheritanceTree,
@@ -768,6 +2820,15 @@ void Integer::cgen(
   context.emit_la(registers::a0, context.getConstantLabel(value));
 }
 
+void Integer::cgenValue(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  loadImmediate(context, registers::a0, value);
+}
+
 void String::cgen(
   CGenContext &context,
   const InheritanceTree &inheritanceTree,
@@ -783,5 +2844,14 @@ void Boolean::cgen(
   const Program *program,
   Symbol *currentType,
   Environment &env) const {
-  context.emit_la(registers::a0, value ? "bool_const1" : "bool_const0");
-}
\ No newline at end of file
+  context.emit_la(registers::a0, context.getLabel(value ? "bool_const1" : "bool_const0"));
+}
+
+void Boolean::cgenValue(
+  CGenContext &context,
+  const InheritanceTree &inheritanceTree,
+  const Program *program,
+  Symbol *currentType,
+  Environment &env) const {
+  context.emit_li(registers::a0, value ? 1 : 0);
+}
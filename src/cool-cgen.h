@@ -64,44 +64,386 @@
  *
  */
 
+#include "cool-mips.h"
+#include "cool-peephole.h"
+#include "cool-reach.h"
 #include "cool-tree.h"
 #include "cool-type.h"
 
-#include <cctype>
-#include <iostream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+/**
+ * Location of an expression temporary: a register, or a slot of the frame
+ * (`reg` is `Reg::zero`) when the registers are exhausted.
+ */
+struct Temporary {
+  Reg reg;
+  int frameOffset;
+};
+
+/**
+ * Number of dynamic dispatch sites, of those turned into direct calls because
+ * no class derived from the static type of the receiver overrides the method,
+ * and of those dispatched through an inline cache. The calls replaced by the
+ * body of their target are counted by target method, whether the dispatch is
+ * dynamic or static, like the calls in tail position reusing the frame of
+ * their caller.
+ */
+struct DispatchStats {
+  unsigned long sites = 0;
+  unsigned long devirtualized = 0;
+  unsigned long cached = 0;
+  unsigned long tailCalls = 0;
+  std::map<std::string, unsigned long> inlined;
+
+  void add(const DispatchStats &other) {
+    sites += other.sites;
+    devirtualized += other.devirtualized;
+    cached += other.cached;
+    tailCalls += other.tailCalls;
+    for (const auto &item : other.inlined) {
+      inlined[item.first] += item.second;
+    }
+  }
+
+  void print(std::ostream &out) const;
+};
+
+/**
+ * Runtime checks of dispatches and case expressions on void, and how many of
+ * them were found dead, see `VoidContext`.
+ */
+struct VoidCheckStats {
+  unsigned long checks = 0;
+  unsigned long eliminated = 0;
+
+  void add(const VoidCheckStats &other) {
+    checks += other.checks;
+    eliminated += other.eliminated;
+  }
+
+  void print(std::ostream &out) const;
+};
+
+/**
+ * Number of methods generated, and of those left without a frame because they
+ * call nothing and keep nothing in the frame.
+ */
+struct FrameStats {
+  unsigned long methods = 0;
+  unsigned long elided = 0;
+
+  void add(const FrameStats &other) {
+    methods += other.methods;
+    elided += other.elided;
+  }
+
+  void print(std::ostream &out) const;
+};
+
 class CGenContext {
+  unsigned int threads;
+  bool optimize;
   unsigned int label;
-  std::unordered_map<std::string, std::string> strConstants;
-  std::unordered_map<int, std::string> intConstants;
+  std::unordered_map<std::string, GlobalLabel> strConstants;
+  std::unordered_map<int, GlobalLabel> intConstants;
+
+  /* Names of the global labels, indexed by id */
+  std::vector<std::string> labelNames;
+  std::unordered_map<std::string, GlobalLabel> labelIds;
+
+  /* Labels derived from class and method names, cached so that code
+   * generation does not build their names over and over again */
+  std::map<std::pair<Symbol *, Symbol *>, GlobalLabel> methodLabels;
+  std::unordered_map<Symbol *, GlobalLabel> initLabels;
+  std::unordered_map<Symbol *, GlobalLabel> protObjLabels;
+
+  /* Labels declared with .globl */
+  std::vector<GlobalLabel> globals;
+
+  /* Instructions of the method currently being generated */
+  MethodCode code;
+
+  /* Frame of the method currently being generated: the number of slots for
+   * local variables, the spill slots and temporary registers in use, and the
+   * position of the frame setup and teardowns to complete in `endMethod` */
+  unsigned int frameLocals;
+  unsigned int spills;
+  unsigned int maxSpills;
+  unsigned int scratchTemporaries;
+  unsigned int savedTemporaries;
+  unsigned int maxSavedTemporaries;
+  size_t frameSetup;
+  std::vector<size_t> frameTeardowns;
+  /* Start of the body after the frame setup, labeled in `endMethod` if a
+   * method calls itself in tail position */
+  size_t frameEntry;
+  unsigned int entryLabel;
+  bool entryUsed;
+
+  /* `let` variables of the method currently being generated that hold raw
+   * values, see `RepresentationContext` */
+  std::unordered_set<const Definition *> unboxedLocals;
+
+  /* Dispatches and case expressions of the method currently being generated
+   * that need no void check */
+  std::unordered_set<const Expression *> unchecked;
+
+  /* Dispatches in tail position of the method currently being generated,
+   * for each body of `inlining`. The tail calls of a body inlined in tail
+   * position are tail calls of the method. */
+  std::vector<std::unordered_set<const Dispatch *>> tailCalls;
+
+  /* Calls to the runtime error routines of the method currently being
+   * generated, moved out of line to its end, see `emit_void_check` */
+  struct AbortCall {
+    unsigned int label;
+    GlobalLabel stub;
+    GlobalLabel fileName;
+    int line;
+  };
+  std::vector<AbortCall> abortCalls;
+
+  /* Entries of the table giving the source line of each out-of-line call to a
+   * runtime error routine, see `cgenAbortStubs` */
+  std::vector<DataItem> lineTable;
+
+  /* Method currently being generated, if any, followed by the methods being
+   * inlined into it */
+  std::vector<const MethodInfo *> inlining;
+
+  /* Global labels defined in the method currently being generated */
+  unsigned int codeLabels;
+
+  /* Classes and methods in use, shared with the shards; not computed
+   * without optimizations, when everything is generated */
+  std::shared_ptr<const ReachContext> reachability;
+
+  /* Program defining each class, set by `cgen` on the shards */
+  const std::unordered_map<Symbol *, const Program *> *classPrograms;
+
+  /* Methods generated so far */
+  std::vector<MethodCode> methods;
+
+  /* Classes generated into contexts of their own, in program order, with the
+   * number of local labels preceding each of them */
+  std::vector<std::unique_ptr<CGenContext>> shards;
+  std::vector<unsigned int> labelBases;
+
+  std::vector<DataItem> data;
+
+  PeepholeStats peepholeStats;
+  DispatchStats dispatchStats;
+  VoidCheckStats voidCheckStats;
+  FrameStats frameStats;
+
+  void append(Opcode opcode, Reg rd, Reg rs, Reg rt, int imm = 0, GlobalLabel sym = GlobalLabel::none) {
+    code.instructions.push_back({ opcode, rd, rs, rt, imm, sym });
+  }
+
+  void cgenClass(const InheritanceTree &inheritanceTree, const Program *program, const ClassInfo *classInfo);
 
-  std::ostream &stream;
+  /**
+   * @brief Generate the stubs the out-of-line void checks call, which look up
+   * the file name and line of the call site in the table `_abort_lines` by
+   * return address and pass them on to the runtime error routines.
+   */
+  void cgenAbortStubs(void);
+
+  /**
+   * Append the out-of-line calls of `emit_void_check` to the method currently
+   * being generated.
+   */
+  void emitAbortCalls(void);
+
+  /**
+   * @brief Drop the frame of the method currently being generated if it is a
+   * leaf: it calls nothing that returns, and only addresses its arguments in
+   * the frame. The arguments are then addressed relative to $sp, and self
+   * moves from $s0, which must be preserved, to $t0 or stays in $a0.
+   * @return whether the frame was dropped.
+   */
+  bool elideFrame(void);
+
+  /**
+   * Complete the frame of the method currently being generated, see
+   * `endMethod`.
+   */
+  void completeFrame(void);
+
+  bool isInstantiated(const ClassInfo *classInfo) const {
+    return !reachability || reachability->isInstantiated(classInfo);
+  }
+
+  bool isInitialized(const ClassInfo *classInfo) const {
+    return !reachability || reachability->isInitialized(classInfo);
+  }
+
+  /**
+   * @return whether the initialization method or any method of the class is
+   * generated.
+   */
+  bool isGenerated(const ClassInfo *classInfo) const;
+
+  /**
+   * Add the constants of `shard` to this context and rename their labels in
+   * `shard` accordingly.
+   */
+  void mergeConstants(CGenContext &shard);
 
 public:
-  CGenContext(std::ostream &stream) : label(0), stream(stream) {}
+  /**
+   * @param threads number of threads to generate and write the classes on.
+   * @param optimize whether to enable the code generation optimizations.
+   */
+  explicit CGenContext(unsigned int threads = 1, bool optimize = true) :
+    threads(threads), optimize(optimize), label(0), labelNames(1), classPrograms(nullptr) {}
 
   void cgen(const InheritanceTree &inheritanceTree, const std::vector<Program *> &programs);
 
+  /**
+   * Write the generated program to `out` as SPIM assembly.
+   */
+  bool write(std::ostream &out) const;
+
+  /**
+   * Write the generated program to `out` as an ELF relocatable object.
+   */
+  bool writeObject(std::ostream &out) const;
+
+  const PeepholeStats &getPeepholeStats(void) const {
+    return peepholeStats;
+  }
+
+  const DispatchStats &getDispatchStats(void) const {
+    return dispatchStats;
+  }
+
+  DispatchStats &getDispatchStats(void) {
+    return dispatchStats;
+  }
+
+  const VoidCheckStats &getVoidCheckStats(void) const {
+    return voidCheckStats;
+  }
+
+  const FrameStats &getFrameStats(void) const {
+    return frameStats;
+  }
+
+  bool isOptimizing(void) const {
+    return optimize;
+  }
+
+  const ReachContext *getReachability(void) const {
+    return reachability.get();
+  }
+
+  /**
+   * @return whether the code of `methodInfo` is generated.
+   */
+  bool isReachable(const MethodInfo *methodInfo) const {
+    return !reachability || reachability->isReachable(methodInfo);
+  }
+
+  /**
+   * @return the classes that may be instantiated, or `nullptr` for all.
+   */
+  const std::unordered_set<const ClassInfo *> *getInstantiatedClasses(void) const {
+    return reachability ? &reachability->getInstantiated() : nullptr;
+  }
+
   unsigned int newLabel(void) {
     return label++;
   }
 
-  std::string getConstantLabel(const std::string &sVal) {
+  /**
+   * @return the id of the global label `name`.
+   */
+  GlobalLabel getLabel(const std::string &name) {
+    auto iter = labelIds.find(name);
+    if (iter == labelIds.cend()) {
+      GlobalLabel id = static_cast<GlobalLabel>(labelNames.size());
+      labelNames.push_back(name);
+      iter = labelIds.insert({ name, id }).first;
+    }
+    return iter->second;
+  }
+
+  const std::string &getLabelName(GlobalLabel label) const {
+    return labelNames[static_cast<unsigned int>(label)];
+  }
+
+  /**
+   * @return a new global label `<method>.<kind><N>` for the method currently
+   * being generated, to refer to its code from the data: `case` for the
+   * targets of jump tables, `abort` for the returns of the abort calls.
+   */
+  GlobalLabel newCodeLabel(const char *kind = "case") {
+    return getLabel(getLabelName(code.name) + "." + kind + std::to_string(codeLabels++));
+  }
+
+  /**
+   * @brief Add a jump table to the data, with the addresses of the code
+   * labels `targets`.
+   * @return the label of the table.
+   */
+  GlobalLabel newJumpTable(const std::vector<GlobalLabel> &targets);
+
+  /**
+   * @return the id of the label `<typeName>.<methodName>`.
+   */
+  GlobalLabel getMethodLabel(Symbol *typeName, Symbol *methodName) {
+    auto iter = methodLabels.find({ typeName, methodName });
+    if (iter == methodLabels.cend()) {
+      GlobalLabel id = getLabel(typeName->to_string() + "." + methodName->to_string());
+      iter = methodLabels.insert({ { typeName, methodName }, id }).first;
+    }
+    return iter->second;
+  }
+
+  /**
+   * @return the id of the label `<typeName>_init`.
+   */
+  GlobalLabel getInitLabel(Symbol *typeName) {
+    auto iter = initLabels.find(typeName);
+    if (iter == initLabels.cend()) {
+      iter = initLabels.insert({ typeName, getLabel(typeName->to_string() + "_init") }).first;
+    }
+    return iter->second;
+  }
+
+  /**
+   * @return the id of the label `<typeName>_protObj`.
+   */
+  GlobalLabel getProtObjLabel(Symbol *typeName) {
+    auto iter = protObjLabels.find(typeName);
+    if (iter == protObjLabels.cend()) {
+      iter = protObjLabels.insert({ typeName, getLabel(typeName->to_string() + "_protObj") }).first;
+    }
+    return iter->second;
+  }
+
+  GlobalLabel getConstantLabel(const std::string &sVal) {
     auto iter = strConstants.find(sVal);
     if (iter == strConstants.cend()) {
-      auto insertion = strConstants.insert({ sVal, "str_const" + std::to_string(strConstants.size()) });
+      auto insertion = strConstants.insert({ sVal, getLabel("str_const" + std::to_string(strConstants.size())) });
       return insertion.first->second;
     } else {
       return iter->second;
     }
   }
 
-  std::string  getConstantLabel(int iVal) {
+  GlobalLabel getConstantLabel(int iVal) {
     auto iter = intConstants.find(iVal);
     if (iter == intConstants.cend()) {
-      auto insertion = intConstants.insert({ iVal, "int_const" + std::to_string(intConstants.size()) });
+      auto insertion = intConstants.insert({ iVal, getLabel("int_const" + std::to_string(intConstants.size())) });
       return insertion.first->second;
     }
     else {
@@ -109,285 +451,508 @@ public:
     }
   }
 
+  /**
+   * Start collecting the instructions of the method labelled `name`, the
+   * code of `methodInfo` or an initialization method if `nullptr`. The
+   * `emit_*` instruction helpers append to it until `endMethod` is called.
+   */
+  void beginMethod(GlobalLabel name, const MethodInfo *methodInfo = nullptr) {
+    code.clear();
+    code.name = name;
+    frameLocals = 0;
+    spills = 0;
+    maxSpills = 0;
+    scratchTemporaries = 0;
+    savedTemporaries = 0;
+    maxSavedTemporaries = 0;
+    frameSetup = 0;
+    frameTeardowns.clear();
+    frameEntry = 0;
+    entryUsed = false;
+    unboxedLocals.clear();
+    unchecked.clear();
+    abortCalls.clear();
+    codeLabels = 0;
+    inlining.clear();
+    tailCalls.clear();
+    if (methodInfo) {
+      inlining.push_back(methodInfo);
+      tailCalls.emplace_back();
+    }
+  }
+
+  /**
+   * @brief Choose the representation of the `let` variables of `exprs`, the
+   * bodies of the method currently being generated or of a method inlined
+   * into it.
+   *
+   * Without optimizations, all the variables are boxed.
+   */
+  void chooseRepresentations(const std::vector<const Expression *> &exprs);
+
+  bool isUnboxed(const Definition *def) const {
+    return unboxedLocals.count(def) != 0;
+  }
+
+  /**
+   * @brief Find the dispatches and case expressions of `exprs`, given like to
+   * `chooseRepresentations`, whose receiver or scrutinee is never void.
+   *
+   * Without optimizations, all of them are checked.
+   */
+  void findUnchecked(const std::vector<const Expression *> &exprs);
+
+  /**
+   * @brief Count the void check of the dispatch or case expression `node`.
+   * @return whether the check must be generated.
+   */
+  bool needsVoidCheck(const Expression *node) {
+    voidCheckStats.checks++;
+    if (unchecked.count(node) != 0) {
+      voidCheckStats.eliminated++;
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Emit the runtime error check of the receiver of a dispatch or the
+   * scrutinee of a case expression, in $a0, against void: the runtime routine
+   * `routine` is called with the file name and the line of the expression.
+   *
+   * With optimizations, the hot path is reduced to a branch to the end of
+   * the method, where a single call to `stub` takes the place of the
+   * arguments. The checks of a method sharing a line share that call.
+   */
+  void emit_void_check(const std::string &routine, const std::string &stub, GlobalLabel fileName, int line);
+
+  /**
+   * @brief Find the dispatches in tail position of `expr`, the body of the
+   * method currently being generated.
+   *
+   * Without optimizations, there are none.
+   */
+  void findTailCalls(const Expression *expr);
+
+  bool isTailCall(const Dispatch *dispatch) const {
+    return !tailCalls.empty() && tailCalls.back().count(dispatch) != 0;
+  }
+
+  /**
+   * @brief Whether `dispatch`, with `argc` arguments, may reuse the frame of
+   * the method currently being generated: it must be in tail position, and
+   * its arguments must fit in the space of the method's arguments.
+   */
+  bool canTailCall(const Dispatch *dispatch, size_t argc) const {
+    return isTailCall(dispatch) && argc <= inlining.front()->methType.paramDecls.size();
+  }
+
+  /**
+   * @return whether `methodInfo` is the method currently being generated.
+   */
+  bool isCurrentMethod(const MethodInfo *methodInfo) const {
+    return methodInfo && !inlining.empty() && inlining.front() == methodInfo;
+  }
+
+  /**
+   * @brief Whether a call to `methodInfo` may be replaced by its body.
+   *
+   * Only the small methods written in Cool are inlined, up to a few levels of
+   * nesting, and never into themselves.
+   */
+  bool canInline(const MethodInfo *methodInfo) const;
+
+  /**
+   * Count a call inlined to `methodInfo`, whose body is generated until the
+   * matching `leaveInline`.
+   * @param tail whether the call is in tail position.
+   */
+  void enterInline(const MethodInfo *methodInfo, bool tail);
+
+  void leaveInline(void) {
+    inlining.pop_back();
+    tailCalls.pop_back();
+  }
+
+  /**
+   * @return the program defining the class `typeName`.
+   */
+  const Program *getProgram(Symbol *typeName) const {
+    return classPrograms->find(typeName)->second;
+  }
+
+  /**
+   * Complete the frame of the method with the spill slots and the callee-saved
+   * registers its temporaries needed, or drop it for a leaf method, and add
+   * the method to the generated methods.
+   */
+  void endMethod(void);
+
+  /**
+   * Emit the frame setup of a method with room for `locals` local variables.
+   * Self is moved to $s0.
+   */
+  void emit_prologue(unsigned int locals);
+
+  /**
+   * Emit the frame teardown of a method, which pops its `params` arguments,
+   * and the return.
+   */
+  void emit_epilogue(unsigned int params);
+
+  /**
+   * Emit the frame teardown of the method before a tail call: the `argc`
+   * arguments of the call, at the top of the stack, replace the arguments of
+   * the method, whose caller the callee returns to.
+   */
+  void emit_tail_epilogue(unsigned int argc);
+
+  /**
+   * Emit a tail call of the method currently being generated to itself: the
+   * `argc` arguments at the top of the stack replace the arguments of the
+   * method, and the receiver in $a0 becomes self, in the same frame.
+   */
+  void emit_self_tail_call(unsigned int argc);
+
+  /**
+   * @brief Allocate a temporary for an intermediate value of an expression.
+   *
+   * Temporaries that must survive calls to Cool methods are kept in the
+   * callee-saved registers $s1-$s6, the others in $t5-$t9, which the runtime
+   * routines leave alone. A temporary is spilled to the frame when those are
+   * exhausted, or always in the stack machine mode (`-O0`). Temporaries are
+   * freed in the reverse order of their allocation.
+   *
+   * @param acrossCalls whether the value is live across a call to a method.
+   */
+  Temporary allocTemporary(bool acrossCalls);
+
+  void freeTemporary(const Temporary &temporary);
+
+  /**
+   * @brief Allocate `count` consecutive slots of the frame, freed together
+   * with `freeFrameSlots` in the reverse order of allocation like the
+   * temporaries.
+   *
+   * @return the offset of the first slot, the others are below it.
+   */
+  int allocFrameSlots(unsigned int count);
+
+  void freeFrameSlots(unsigned int count) {
+    spills -= count;
+  }
+
+  /**
+   * Copy `src` into `temporary`.
+   */
+  void emit_store(const Temporary &temporary, Reg src);
+
+  /**
+   * @return a register holding the value of `temporary`, which is loaded into
+   * `scratch` if the temporary was spilled.
+   */
+  Reg emit_load(const Temporary &temporary, Reg scratch);
+
   void emit_label(unsigned int label_id) {
-    stream << "label" << label_id << ":" << std::endl;
+    append(Opcode::label, Reg::zero, Reg::zero, Reg::zero, static_cast<int>(label_id));
+  }
+
+  /**
+   * Define the global label `label`, see `newCodeLabel`.
+   */
+  void emit_code_label(GlobalLabel label) {
+    append(Opcode::label, Reg::zero, Reg::zero, Reg::zero, 0, label);
+  }
+
+  /**
+   * Data directives
+   */
+
+  void emit_label(GlobalLabel label) {
+    data.push_back({ DataOp::label, 0, label, std::string() });
   }
 
   void emit_label(const std::string &label) {
-    stream << label << ":" << std::endl;
+    emit_label(getLabel(label));
   }
 
   void emit_globl(const std::string &label) {
-    stream << "\t.globl\t" << label << std::endl;
+    globals.push_back(getLabel(label));
   }
 
   void emit_align(unsigned int align) {
-    stream << "\t.align\t" << align << std::endl;
+    data.push_back({ DataOp::align, static_cast<int>(align), GlobalLabel::none, std::string() });
+  }
+
+  void emit_word(GlobalLabel label) {
+    data.push_back({ DataOp::word, 0, label, std::string() });
   }
 
   void emit_word(const std::string &label) {
-    stream << "\t.word\t" << label << std::endl;
+    emit_word(getLabel(label));
   }
 
   void emit_word(int value) {
-    stream << "\t.word\t" << value << std::endl;
+    data.push_back({ DataOp::word, value, GlobalLabel::none, std::string() });
   }
 
   void emit_byte(unsigned char byte) {
-    stream << "\t.byte\t" << byte << std::endl;
+    data.push_back({ DataOp::byte, byte, GlobalLabel::none, std::string() });
   }
 
-  void emit_ascii(const std::string &value);
+  void emit_ascii(const std::string &value) {
+    data.push_back({ DataOp::ascii, 0, GlobalLabel::none, value });
+  }
 
   /**
    * R-type instructions
    */
 
-  void emit_sll(const std::string &rd, const std::string &rt, unsigned char shamt) {
-    stream << "\tsll\t" << rd << ", " << rt << ", " << (shamt & 0x1f) << std::endl;
+  void emit_sll(Reg rd, Reg rt, unsigned char shamt) {
+    append(Opcode::sll, rd, Reg::zero, rt, shamt & 0x1f);
   }
 
-  void emit_srl(const std::string &rd, const std::string &rt, unsigned char shamt) {
-    stream << "\tsrl\t" << rd << ", " << rt << ", " << (shamt & 0x1f) << std::endl;
+  void emit_srl(Reg rd, Reg rt, unsigned char shamt) {
+    append(Opcode::srl, rd, Reg::zero, rt, shamt & 0x1f);
   }
 
-  void emit_sra(const std::string &rd, const std::string &rt, unsigned char shamt) {
-    stream << "\tsra\t" << rd << ", " << rt << ", " << (shamt & 0x1f) << std::endl;
+  void emit_sra(Reg rd, Reg rt, unsigned char shamt) {
+    append(Opcode::sra, rd, Reg::zero, rt, shamt & 0x1f);
   }
 
-  void emit_sllv(const std::string &rd, const std::string &rt, const std::string &rs) {
-    stream << "\tsllv\t" << rd << ", " << rt << ", " << rs << std::endl;
+  void emit_sllv(Reg rd, Reg rt, Reg rs) {
+    append(Opcode::sllv, rd, rs, rt);
   }
 
-  void emit_srlv(const std::string &rd, const std::string &rt, const std::string &rs) {
-    stream << "\tsrlv\t" << rd << ", " << rt << ", " << rs << std::endl;
+  void emit_srlv(Reg rd, Reg rt, Reg rs) {
+    append(Opcode::srlv, rd, rs, rt);
   }
 
-  void emit_srav(const std::string &rd, const std::string &rt, const std::string &rs) {
-    stream << "\tsrav\t" << rd << ", " << rt << ", " << rs << std::endl;
+  void emit_srav(Reg rd, Reg rt, Reg rs) {
+    append(Opcode::srav, rd, rs, rt);
   }
 
-  void emit_jr(const std::string &rs) {
-    stream << "\tjr\t" << rs << std::endl;
+  void emit_jr(Reg rs) {
+    append(Opcode::jr, Reg::zero, rs, Reg::zero);
   }
 
-  void emit_jalr(const std::string &rd, const std::string &rs) {
-    stream << "\tjalr\t" << rd << ", " << rs << std::endl;
+  void emit_jalr(Reg rd, Reg rs) {
+    append(Opcode::jalr, rd, rs, Reg::zero);
   }
 
-  void emit_jalr(const std::string &rs) {
-    stream << "\tjalr\t" << rs << std::endl;
+  void emit_jalr(Reg rs) {
+    append(Opcode::jalr, Reg::ra, rs, Reg::zero);
   }
 
   void emit_syscall(void) {
-    stream << "\tsyscall" << std::endl;
+    append(Opcode::syscall, Reg::zero, Reg::zero, Reg::zero);
   }
 
-  void emit_mfhi(const std::string &rd) {
-    stream << "\tmfhi\t" << rd << std::endl;
+  void emit_mfhi(Reg rd) {
+    append(Opcode::mfhi, rd, Reg::zero, Reg::zero);
   }
 
-  void emit_mthi(const std::string &rs) {
-    stream << "\tmthi\t" << rs << std::endl;
+  void emit_mthi(Reg rs) {
+    append(Opcode::mthi, Reg::zero, rs, Reg::zero);
   }
 
-  void emit_mflo(const std::string &rd) {
-    stream << "\tmflo\t" << rd << std::endl;
+  void emit_mflo(Reg rd) {
+    append(Opcode::mflo, rd, Reg::zero, Reg::zero);
   }
 
-  void emit_mtlo(const std::string &rs) {
-    stream << "\tmtlo\t" << rs << std::endl;
+  void emit_mtlo(Reg rs) {
+    append(Opcode::mtlo, Reg::zero, rs, Reg::zero);
   }
 
-  void emit_mult(const std::string &rs, const std::string &rt) {
-    stream << "\tmult\t" << rs << ", " << rt << std::endl;
+  void emit_mult(Reg rs, Reg rt) {
+    append(Opcode::mult, Reg::zero, rs, rt);
   }
 
-  void emit_multu(const std::string &rs, const std::string &rt) {
-    stream << "\tmultu\t" << rs << ", " << rt << std::endl;
+  void emit_multu(Reg rs, Reg rt) {
+    append(Opcode::multu, Reg::zero, rs, rt);
   }
 
-  void emit_div(const std::string &rs, const std::string &rt) {
-    stream << "\tdiv\t" << rs << ", " << rt << std::endl;
+  void emit_div(Reg rs, Reg rt) {
+    append(Opcode::div, Reg::zero, rs, rt);
   }
 
-  void emit_divu(const std::string &rs, const std::string &rt) {
-    stream << "\tdivu\t" << rs << ", " << rt << std::endl;
+  void emit_divu(Reg rs, Reg rt) {
+    append(Opcode::divu, Reg::zero, rs, rt);
   }
 
-  void emit_add(const std::string &rd, const std::string &rs, const std::string &rt) {
-    stream << "\tadd\t" << rd << ", " << rs << ", " << rt << std::endl;
+  void emit_add(Reg rd, Reg rs, Reg rt) {
+    append(Opcode::add, rd, rs, rt);
   }
 
-  void emit_addu(const std::string &rd, const std::string &rs, const std::string &rt) {
-    stream << "\taddu\t" << rd << ", " << rs << ", " << rt << std::endl;
+  void emit_addu(Reg rd, Reg rs, Reg rt) {
+    append(Opcode::addu, rd, rs, rt);
   }
 
-  void emit_sub(const std::string &rd, const std::string &rs, const std::string &rt) {
-    stream << "\tsub\t" << rd << ", " << rs << ", " << rt << std::endl;
+  void emit_sub(Reg rd, Reg rs, Reg rt) {
+    append(Opcode::sub, rd, rs, rt);
   }
 
-  void emit_subu(const std::string &rd, const std::string &rs, const std::string &rt) {
-    stream << "\tsubu\t" << rd << ", " << rs << ", " << rt << std::endl;
+  void emit_subu(Reg rd, Reg rs, Reg rt) {
+    append(Opcode::subu, rd, rs, rt);
   }
 
-  void emit_and(const std::string &rd, const std::string &rs, const std::string &rt) {
-    stream << "\tand\t" << rd << ", " << rs << ", " << rt << std::endl;
+  void emit_and(Reg rd, Reg rs, Reg rt) {
+    append(Opcode::and_, rd, rs, rt);
   }
 
-  void emit_or(const std::string &rd, const std::string &rs, const std::string &rt) {
-    stream << "\tor\t" << rd << ", " << rs << ", " << rt << std::endl;
+  void emit_or(Reg rd, Reg rs, Reg rt) {
+    append(Opcode::or_, rd, rs, rt);
   }
 
-  void emit_xor(const std::string &rd, const std::string &rs, const std::string &rt) {
-    stream << "\txor\t" << rd << ", " << rs << ", " << rt << std::endl;
+  void emit_xor(Reg rd, Reg rs, Reg rt) {
+    append(Opcode::xor_, rd, rs, rt);
   }
 
-  void emit_nor(const std::string &rd, const std::string &rs, const std::string &rt) {
-    stream << "\tnor\t" << rd << ", " << rs << ", " << rt << std::endl;
+  void emit_nor(Reg rd, Reg rs, Reg rt) {
+    append(Opcode::nor, rd, rs, rt);
   }
 
-  void emit_slt(const std::string &rd, const std::string &rs, const std::string &rt) {
-    stream << "\tslt\t" << rd << ", " << rs << ", " << rt << std::endl;
+  void emit_slt(Reg rd, Reg rs, Reg rt) {
+    append(Opcode::slt, rd, rs, rt);
   }
 
-  void emit_sltu(const std::string &rd, const std::string &rs, const std::string &rt) {
-    stream << "\tsltu\t" << rd << ", " << rs << ", " << rt << std::endl;
+  void emit_sltu(Reg rd, Reg rs, Reg rt) {
+    append(Opcode::sltu, rd, rs, rt);
   }
 
   /**
    * J-type instructions
    */
 
-  void emit_j(const std::string &label) {
-    stream << "\tj\t" << label << std::endl;
+  void emit_j(GlobalLabel label) {
+    append(Opcode::j, Reg::zero, Reg::zero, Reg::zero, 0, label);
   }
 
   void emit_j(unsigned int label) {
-    stream << "\tj\t label" << label << std::endl;
+    append(Opcode::j, Reg::zero, Reg::zero, Reg::zero, static_cast<int>(label));
   }
 
-  void emit_jal(const std::string &label) {
-    stream << "\tjal\t" << label << std::endl;
+  void emit_jal(GlobalLabel label) {
+    append(Opcode::jal, Reg::zero, Reg::zero, Reg::zero, 0, label);
   }
 
   /**
    * I-type instructions
    */
 
-  void emit_beq(const std::string &rs, const std::string &rt, unsigned int label) {
-    stream << "\tbeq\t" << rs << ", " << rt << ", label" << label << std::endl;
+  void emit_beq(Reg rs, Reg rt, unsigned int label) {
+    append(Opcode::beq, Reg::zero, rs, rt, static_cast<int>(label));
   }
 
-  void emit_bne(const std::string &rs, const std::string &rt, unsigned int label) {
-    stream << "\tbne\t" << rs << ", " << rt << ", label" << label << std::endl;
+  void emit_bne(Reg rs, Reg rt, unsigned int label) {
+    append(Opcode::bne, Reg::zero, rs, rt, static_cast<int>(label));
   }
 
-  void emit_blez(const std::string &rs, unsigned int label) {
-    stream << "\tblez\t" << rs << ", label" << label << std::endl;
+  void emit_blez(Reg rs, unsigned int label) {
+    append(Opcode::blez, Reg::zero, rs, Reg::zero, static_cast<int>(label));
   }
 
-  void emit_bgtz(const std::string &rs, unsigned int label) {
-    stream << "\tbgtz\t" << rs << ", label" << label << std::endl;
+  void emit_bgtz(Reg rs, unsigned int label) {
+    append(Opcode::bgtz, Reg::zero, rs, Reg::zero, static_cast<int>(label));
   }
 
-  void emit_addi(const std::string &rt, const std::string &rs, short imm) {
-    stream << "\taddi\t" << rt << ", " << rs << ", " << imm << std::endl;
+  void emit_addi(Reg rt, Reg rs, short imm) {
+    append(Opcode::addi, Reg::zero, rs, rt, imm);
   }
 
-  void emit_addiu(const std::string &rt, const std::string &rs, short imm) {
-    stream << "\taddiu\t" << rt << ", " << rs << ", " << imm << std::endl;
+  void emit_addiu(Reg rt, Reg rs, short imm) {
+    append(Opcode::addiu, Reg::zero, rs, rt, imm);
   }
 
-  void emit_slti(const std::string &rt, const std::string &rs, short imm) {
-    stream << "\tslti\t" << rt << ", " << rs << ", " << imm << std::endl;
+  void emit_slti(Reg rt, Reg rs, short imm) {
+    append(Opcode::slti, Reg::zero, rs, rt, imm);
   }
 
-  void emit_sltiu(const std::string &rt, const std::string &rs, short imm) {
-    stream << "\tsltiu\t" << rt << ", " << rs << ", " << imm << std::endl;
+  void emit_sltiu(Reg rt, Reg rs, short imm) {
+    append(Opcode::sltiu, Reg::zero, rs, rt, imm);
   }
 
-  void emit_andi(const std::string &rt, const std::string &rs, unsigned short imm) {
-    stream << "\tandi\t" << rt << ", " << rs << ", " << imm << std::endl;
+  void emit_andi(Reg rt, Reg rs, unsigned short imm) {
+    append(Opcode::andi, Reg::zero, rs, rt, imm);
   }
 
-  void emit_ori(const std::string &rt, const std::string &rs, unsigned short imm) {
-    stream << "\tori\t" << rt << ", " << rs << ", " << imm << std::endl;
+  void emit_ori(Reg rt, Reg rs, unsigned short imm) {
+    append(Opcode::ori, Reg::zero, rs, rt, imm);
   }
 
-  void emit_xori(const std::string &rt, const std::string &rs, unsigned short imm) {
-    stream << "\txori\t" << rt << ", " << rs << ", " << imm << std::endl;
+  void emit_xori(Reg rt, Reg rs, unsigned short imm) {
+    append(Opcode::xori, Reg::zero, rs, rt, imm);
   }
 
-  void emit_lui(const std::string &rt, unsigned short imm) {
-    stream << "\tlui\t" << rt << ", " << imm << std::endl;
+  void emit_lui(Reg rt, unsigned short imm) {
+    append(Opcode::lui, Reg::zero, Reg::zero, rt, imm);
   }
 
-  void emit_lb(const std::string &rt, const std::string &rs, short imm) {
-    stream << "\tlb\t" << rt << ", " << imm << "(" << rs << ")" << std::endl;
+  void emit_lb(Reg rt, Reg rs, short imm) {
+    append(Opcode::lb, Reg::zero, rs, rt, imm);
   }
 
-  void emit_lh(const std::string &rt, const std::string &rs, short imm) {
-    stream << "\tlh\t" << rt << ", " << imm << "(" << rs << ")" << std::endl;
+  void emit_lh(Reg rt, Reg rs, short imm) {
+    append(Opcode::lh, Reg::zero, rs, rt, imm);
   }
 
-  void emit_lw(const std::string &rt, const std::string &rs, short imm) {
-    stream << "\tlw\t" << rt << ", " << imm << "(" << rs << ")" << std::endl;
+  void emit_lw(Reg rt, Reg rs, short imm) {
+    append(Opcode::lw, Reg::zero, rs, rt, imm);
   }
 
-  void emit_lbu(const std::string &rt, const std::string &rs, short imm) {
-    stream << "\tlbu\t" << rt << ", " << imm << "(" << rs << ")" << std::endl;
+  void emit_lbu(Reg rt, Reg rs, short imm) {
+    append(Opcode::lbu, Reg::zero, rs, rt, imm);
   }
 
-  void emit_lhu(const std::string &rt, const std::string &rs, short imm) {
-    stream << "\tlhu\t" << rt << ", " << imm << "(" << rs << ")" << std::endl;
+  void emit_lhu(Reg rt, Reg rs, short imm) {
+    append(Opcode::lhu, Reg::zero, rs, rt, imm);
   }
 
-  void emit_sb(const std::string &rt, const std::string &rs, short imm) {
-    stream << "\tsb\t" << rt << ", " << imm << "(" << rs << ")" << std::endl;
+  void emit_sb(Reg rt, Reg rs, short imm) {
+    append(Opcode::sb, Reg::zero, rs, rt, imm);
   }
 
-  void emit_sh(const std::string &rt, const std::string &rs, short imm) {
-    stream << "\tsh\t" << rt << ", " << imm << "(" << rs << ")" << std::endl;
+  void emit_sh(Reg rt, Reg rs, short imm) {
+    append(Opcode::sh, Reg::zero, rs, rt, imm);
   }
 
-  void emit_sw(const std::string &rt, const std::string &rs, short imm) {
-    stream << "\tsw\t" << rt << ", " << imm << "(" << rs << ")" << std::endl;
+  void emit_sw(Reg rt, Reg rs, short imm) {
+    append(Opcode::sw, Reg::zero, rs, rt, imm);
   }
 
   /**
    * Pseudo-instructions
    */
 
-  void emit_move(const std::string &dst, const std::string &src) {
-    stream << "\tmove\t" << dst << ", " << src << std::endl;
+  void emit_move(Reg dst, Reg src) {
+    append(Opcode::move, dst, src, Reg::zero);
   }
 
-  void emit_li(const std::string &dst, short imm) {
-    stream << "\tli\t" << dst << ", " << imm << std::endl;
+  void emit_li(Reg dst, short imm) {
+    append(Opcode::li, Reg::zero, Reg::zero, dst, imm);
   }
 
-  void emit_lw(const std::string &dst, const std::string &label) {
-    stream << "\tlw\t" << dst << ", " << label << std::endl;
+  void emit_lw(Reg dst, GlobalLabel label) {
+    append(Opcode::lw, Reg::zero, Reg::zero, dst, 0, label);
   }
 
-  void emit_la(const std::string &dst, const std::string &label) {
-    stream << "\tla\t" << dst << ", " << label << std::endl;
+  void emit_la(Reg dst, GlobalLabel label) {
+    append(Opcode::la, Reg::zero, Reg::zero, dst, 0, label);
   }
 
-  void emit_blt(const std::string &r1, const std::string &r2, unsigned int label) {
-    stream << "\tblt\t" << r1 << ", " << r2 << ", label" << label << std::endl;
+  void emit_blt(Reg r1, Reg r2, unsigned int label) {
+    append(Opcode::blt, Reg::zero, r1, r2, static_cast<int>(label));
   }
 
-  void emit_ble(const std::string &r1, const std::string &r2, unsigned int label) {
-    stream << "\tble\t" << r1 << ", " << r2 << ", label" << label << std::endl;
+  void emit_ble(Reg r1, Reg r2, unsigned int label) {
+    append(Opcode::ble, Reg::zero, r1, r2, static_cast<int>(label));
   }
 
-  void emit_bgt(const std::string &r1, const std::string &r2, unsigned int label) {
-    stream << "\tbgt\t" << r1 << ", " << r2 << ", label" << label << std::endl;
+  void emit_bgt(Reg r1, Reg r2, unsigned int label) {
+    append(Opcode::bgt, Reg::zero, r1, r2, static_cast<int>(label));
   }
 
-  void emit_bge(const std::string &r1, const std::string &r2, unsigned int label) {
-    stream << "\tbge\t" << r1 << ", " << r2 << ", label" << label << std::endl;
+  void emit_bge(Reg r1, Reg r2, unsigned int label) {
+    append(Opcode::bge, Reg::zero, r1, r2, static_cast<int>(label));
   }
 };
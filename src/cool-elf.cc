@@ -0,0 +1,239 @@
+#include "cool-elf.h"
+
+#include <algorithm>
+
+enum {
+  SHT_PROGBITS = 1,
+  SHT_SYMTAB = 2,
+  SHT_STRTAB = 3,
+  SHT_REL = 9,
+};
+
+enum {
+  SHF_WRITE = 0x1,
+  SHF_ALLOC = 0x2,
+  SHF_EXECINSTR = 0x4,
+  SHF_INFO_LINK = 0x40,
+};
+
+enum {
+  STB_LOCAL = 0,
+  STB_GLOBAL = 1,
+};
+
+enum {
+  STT_NOTYPE = 0,
+  STT_OBJECT = 1,
+  STT_FUNC = 2,
+  STT_SECTION = 3,
+};
+
+/* Section header indices */
+enum {
+  SEC_TEXT = 1,
+  SEC_DATA,
+  SEC_REL_TEXT,
+  SEC_REL_DATA,
+  SEC_SYMTAB,
+  SEC_STRTAB,
+  SEC_SHSTRTAB,
+  SEC_COUNT,
+};
+
+static const unsigned int EHDR_SIZE = 52;
+static const unsigned int SHDR_SIZE = 40;
+static const unsigned int SYM_SIZE = 16;
+static const unsigned int REL_SIZE = 8;
+
+static const unsigned int EM_MIPS = 8;
+static const unsigned int EF_MIPS_ABI_O32 = 0x00001000;
+static const unsigned int EF_MIPS_ARCH_32 = 0x50000000;
+
+static void put16(std::vector<unsigned char> &out, unsigned int value) {
+  out.push_back(static_cast<unsigned char>(value));
+  out.push_back(static_cast<unsigned char>(value >> 8));
+}
+
+static void put32(std::vector<unsigned char> &out, unsigned int value) {
+  put16(out, value & 0xffff);
+  put16(out, value >> 16);
+}
+
+static void align(std::vector<unsigned char> &out, unsigned int alignment) {
+  while (out.size() % alignment != 0) {
+    out.push_back(0);
+  }
+}
+
+static unsigned int addString(std::vector<unsigned char> &strtab, const std::string &str) {
+  unsigned int offset = static_cast<unsigned int>(strtab.size());
+  strtab.insert(strtab.end(), str.begin(), str.end());
+  strtab.push_back(0);
+  return offset;
+}
+
+unsigned int ElfWriter::getSymbol(const std::string &name) {
+  auto iter = symbolIds.find(name);
+  if (iter == symbolIds.cend()) {
+    unsigned int id = static_cast<unsigned int>(symbols.size());
+    symbols.push_back({ name, TEXT, 0, false, false });
+    iter = symbolIds.insert({ name, id }).first;
+  }
+  return iter->second;
+}
+
+void ElfWriter::append(SectionId section, const MachineCode &code, const std::vector<std::string> &labelNames) {
+  std::vector<unsigned char> &bytes = sections[section];
+  unsigned int base = static_cast<unsigned int>(bytes.size());
+  bytes.insert(bytes.end(), code.bytes.begin(), code.bytes.end());
+
+  for (const auto &definition : code.definitions) {
+    ElfSymbol &symbol = symbols[getSymbol(labelNames[static_cast<unsigned int>(definition.first)])];
+    symbol.section = section;
+    symbol.value = base + definition.second;
+    symbol.defined = true;
+  }
+
+  for (const MachineCode::Fixup &fixup : code.fixups) {
+    unsigned int offset = base + fixup.offset;
+    if (fixup.sym == GlobalLabel::none) {
+      // The addend is stored in the instruction, relative to the start of the
+      // appended code, so rebase it onto the start of the section.
+      unsigned int word = bytes[offset] | bytes[offset + 1] << 8 | bytes[offset + 2] << 16 |
+        static_cast<unsigned int>(bytes[offset + 3]) << 24;
+      word = (word & 0xfc000000) | ((word + (base >> 2)) & 0x3ffffff);
+      for (unsigned int i = 0; i < 4; i++) {
+        bytes[offset + i] = static_cast<unsigned char>(word >> (8 * i));
+      }
+      relocations[section].push_back({ offset, NO_SYMBOL, fixup.type });
+    } else {
+      relocations[section].push_back({ offset, getSymbol(labelNames[static_cast<unsigned int>(fixup.sym)]), fixup.type });
+    }
+  }
+}
+
+bool ElfWriter::write(std::ostream &out) const {
+  // Symbol table: the null symbol and the section symbols, then the local
+  // symbols, then the global and the undefined ones.
+
+  std::vector<unsigned char> strtab(1, 0);
+  std::vector<unsigned char> symtab(SYM_SIZE, 0);
+  std::vector<unsigned int> symbolIndex(symbols.size());
+
+  for (unsigned int section : { SEC_TEXT, SEC_DATA }) {
+    put32(symtab, 0);
+    put32(symtab, 0);
+    put32(symtab, 0);
+    symtab.push_back(STB_LOCAL << 4 | STT_SECTION);
+    symtab.push_back(0);
+    put16(symtab, section);
+  }
+
+  unsigned int index = 3;
+  unsigned int firstGlobal = 0;
+  for (bool global : { false, true }) {
+    if (global) {
+      firstGlobal = index;
+    }
+    for (size_t i = 0; i < symbols.size(); i++) {
+      const ElfSymbol &symbol = symbols[i];
+      if ((symbol.global || !symbol.defined) != global) {
+        continue;
+      }
+      symbolIndex[i] = index++;
+      put32(symtab, addString(strtab, symbol.name));
+      put32(symtab, symbol.defined ? symbol.value : 0);
+      put32(symtab, 0);
+      unsigned int type = !symbol.defined ? STT_NOTYPE : symbol.section == TEXT ? STT_FUNC : STT_OBJECT;
+      symtab.push_back(static_cast<unsigned char>((global ? STB_GLOBAL : STB_LOCAL) << 4 | type));
+      symtab.push_back(0);
+      put16(symtab, symbol.defined ? (symbol.section == TEXT ? SEC_TEXT : SEC_DATA) : 0);
+    }
+  }
+
+  std::vector<unsigned char> rels[2];
+  for (unsigned int section = 0; section < 2; section++) {
+    for (const Rel &rel : relocations[section]) {
+      unsigned int symbol = rel.symbol == NO_SYMBOL ? SEC_TEXT : symbolIndex[rel.symbol];
+      put32(rels[section], rel.offset);
+      put32(rels[section], symbol << 8 | static_cast<unsigned int>(rel.type));
+    }
+  }
+
+  std::vector<unsigned char> shstrtab(1, 0);
+  unsigned int names[SEC_COUNT] = { 0 };
+  names[SEC_TEXT] = addString(shstrtab, ".text");
+  names[SEC_DATA] = addString(shstrtab, ".data");
+  names[SEC_REL_TEXT] = addString(shstrtab, ".rel.text");
+  names[SEC_REL_DATA] = addString(shstrtab, ".rel.data");
+  names[SEC_SYMTAB] = addString(shstrtab, ".symtab");
+  names[SEC_STRTAB] = addString(shstrtab, ".strtab");
+  names[SEC_SHSTRTAB] = addString(shstrtab, ".shstrtab");
+
+  const std::vector<unsigned char> *contents[SEC_COUNT] = {
+    nullptr, &sections[TEXT], &sections[DATA], &rels[TEXT], &rels[DATA], &symtab, &strtab, &shstrtab,
+  };
+
+  // File layout: ELF header, section contents, section header table.
+
+  std::vector<unsigned char> file;
+  file.resize(EHDR_SIZE);
+
+  unsigned int offsets[SEC_COUNT] = { 0 };
+  for (unsigned int i = 1; i < SEC_COUNT; i++) {
+    align(file, 4);
+    offsets[i] = static_cast<unsigned int>(file.size());
+    file.insert(file.end(), contents[i]->begin(), contents[i]->end());
+  }
+  align(file, 4);
+  unsigned int shoff = static_cast<unsigned int>(file.size());
+
+  auto sectionHeader = [&] (unsigned int i, unsigned int type, unsigned int flags, unsigned int link,
+                            unsigned int info, unsigned int alignment, unsigned int entsize) {
+    put32(file, names[i]);
+    put32(file, type);
+    put32(file, flags);
+    put32(file, 0);
+    put32(file, offsets[i]);
+    put32(file, static_cast<unsigned int>(contents[i]->size()));
+    put32(file, link);
+    put32(file, info);
+    put32(file, alignment);
+    put32(file, entsize);
+  };
+
+  file.insert(file.end(), SHDR_SIZE, 0);
+  sectionHeader(SEC_TEXT, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0, 0, 4, 0);
+  sectionHeader(SEC_DATA, SHT_PROGBITS, SHF_WRITE | SHF_ALLOC, 0, 0, 4, 0);
+  sectionHeader(SEC_REL_TEXT, SHT_REL, SHF_INFO_LINK, SEC_SYMTAB, SEC_TEXT, 4, REL_SIZE);
+  sectionHeader(SEC_REL_DATA, SHT_REL, SHF_INFO_LINK, SEC_SYMTAB, SEC_DATA, 4, REL_SIZE);
+  sectionHeader(SEC_SYMTAB, SHT_SYMTAB, 0, SEC_STRTAB, firstGlobal, 4, SYM_SIZE);
+  sectionHeader(SEC_STRTAB, SHT_STRTAB, 0, 0, 0, 1, 0);
+  sectionHeader(SEC_SHSTRTAB, SHT_STRTAB, 0, 0, 0, 1, 0);
+
+  std::vector<unsigned char> header = {
+    0x7f, 'E', 'L', 'F',
+    1, // ELFCLASS32
+    1, // ELFDATA2LSB
+    1, // EV_CURRENT
+    0, 0, 0, 0, 0, 0, 0, 0, 0,
+  };
+  put16(header, 1); // ET_REL
+  put16(header, EM_MIPS);
+  put32(header, 1); // EV_CURRENT
+  put32(header, 0); // e_entry
+  put32(header, 0); // e_phoff
+  put32(header, shoff);
+  put32(header, EF_MIPS_ARCH_32 | EF_MIPS_ABI_O32);
+  put16(header, EHDR_SIZE);
+  put16(header, 0); // e_phentsize
+  put16(header, 0); // e_phnum
+  put16(header, SHDR_SIZE);
+  put16(header, SEC_COUNT);
+  put16(header, SEC_SHSTRTAB);
+  std::copy(header.begin(), header.end(), file.begin());
+
+  out.write(reinterpret_cast<const char *>(file.data()), static_cast<std::streamsize>(file.size()));
+  out.flush();
+  return static_cast<bool>(out);
+}
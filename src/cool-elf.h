@@ -0,0 +1,70 @@
+#pragma once
+
+#include "cool-mips.h"
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Writer for little-endian MIPS32 ELF relocatable objects with a `.text` and a
+ * `.data` section.
+ *
+ * Symbols are identified by name. Symbols that are referenced but never
+ * defined are left undefined, to be resolved against the runtime system by the
+ * linker.
+ */
+class ElfWriter {
+public:
+  enum SectionId {
+    TEXT,
+    DATA,
+  };
+
+private:
+  struct ElfSymbol {
+    std::string name;
+    SectionId section;
+    unsigned int value;
+    bool defined;
+    bool global;
+  };
+
+  struct Rel {
+    unsigned int offset;
+    /* Index into `symbols`, or `NO_SYMBOL` for the .text section itself */
+    unsigned int symbol;
+    Relocation type;
+  };
+
+  static const unsigned int NO_SYMBOL = ~0u;
+
+  std::vector<unsigned char> sections[2];
+  std::vector<Rel> relocations[2];
+  std::vector<ElfSymbol> symbols;
+  std::unordered_map<std::string, unsigned int> symbolIds;
+
+public:
+  ElfWriter(void) = default;
+
+  ElfWriter(const ElfWriter &) = delete;
+  ElfWriter &operator=(const ElfWriter &) = delete;
+
+  /**
+   * @return the id of the symbol `name`, which is created if necessary.
+   */
+  unsigned int getSymbol(const std::string &name);
+
+  void setGlobal(unsigned int symbol) {
+    symbols[symbol].global = true;
+  }
+
+  /**
+   * @brief Append `code` to `section`, translating its labels through
+   * `labelNames`.
+   */
+  void append(SectionId section, const MachineCode &code, const std::vector<std::string> &labelNames);
+
+  bool write(std::ostream &out) const;
+};
@@ -0,0 +1,319 @@
+#include "cool-fold.h"
+
+#include <climits>
+
+bool FoldContext::define(Symbol *name, Expression *value) {
+  if (!propagate || assigned.count(name) != 0) {
+    value = nullptr;
+  }
+  constants.define(name, value);
+  return value != nullptr;
+}
+
+Expression *FoldContext::lookup(Symbol *name) const {
+  Expression *value = nullptr;
+  constants.lookup(name, value);
+  return value;
+}
+
+Expression *FoldContext::newInteger(const TreeNode *origin, int value) {
+  Expression *node = program->new_tree_node<Integer>(program->getLine(origin), value);
+  node->setStaticType(Symbol::Int);
+  return node;
+}
+
+Expression *FoldContext::newBoolean(const TreeNode *origin, bool value) {
+  Expression *node = program->new_tree_node<Boolean>(program->getLine(origin), value);
+  node->setStaticType(Symbol::Bool);
+  return node;
+}
+
+Expression *FoldContext::newString(const TreeNode *origin, const std::string &value) {
+  Expression *node = program->new_tree_node<String>(program->getLine(origin), value);
+  node->setStaticType(Symbol::String);
+  return node;
+}
+
+static bool isConstant(const Expression *expr) {
+  return dynamic_cast<const Integer *>(expr) ||
+    dynamic_cast<const Boolean *>(expr) ||
+    dynamic_cast<const String *>(expr);
+}
+
+/**
+ * @brief Compute `lhs op rhs` the way the generated code does.
+ * @return false if the operation is left to runtime: `add` and `sub` trap on
+ * overflow, and the division by zero keeps its runtime behaviour.
+ */
+static bool evaluate(ArithmeticOperator op, int lhs, int rhs, int &result) {
+  long long value;
+  switch (op) {
+    case ArithmeticOperator::ADD:
+      value = static_cast<long long>(lhs) + rhs;
+      break;
+    case ArithmeticOperator::SUB:
+      value = static_cast<long long>(lhs) - rhs;
+      break;
+    case ArithmeticOperator::MUL:
+      // mult/mflo keep the low word of the product
+      result = static_cast<int>(static_cast<unsigned int>(static_cast<long long>(lhs) * rhs));
+      return true;
+    case ArithmeticOperator::DIV:
+      if (rhs == 0 || (lhs == INT_MIN && rhs == -1)) {
+        return false;
+      }
+      value = lhs / rhs;
+      break;
+    default:
+      return false;
+  }
+
+  if (value < INT_MIN || value > INT_MAX) {
+    return false;
+  }
+  result = static_cast<int>(value);
+  return true;
+}
+
+Expression *Assign::fold(FoldContext &context) {
+  context.addAssigned(left);
+  expr = expr->fold(context);
+  return this;
+}
+
+Expression *Dispatch::fold(FoldContext &context) {
+  if (expr) {
+    expr = expr->fold(context);
+  }
+  for (Expression *&arg : args) {
+    arg = arg->fold(context);
+  }
+  return this;
+}
+
+Expression *Conditional::fold(FoldContext &context) {
+  pred = pred->fold(context);
+  then = then->fold(context);
+  elSe = elSe->fold(context);
+
+  // The arm replaces the conditional only if it has the same static type,
+  // a narrower one would change how the parent evaluates it: an Int compared
+  // to an Object must still go through equality_test.
+  if (const Boolean *value = dynamic_cast<const Boolean *>(pred)) {
+    Expression *arm = value->getValue() ? then : elSe;
+    if (arm->getStaticType() == getStaticType()) {
+      return arm;
+    }
+  }
+  return this;
+}
+
+Expression *Loop::fold(FoldContext &context) {
+  pred = pred->fold(context);
+  body = body->fold(context);
+  return this;
+}
+
+Expression *Block::fold(FoldContext &context) {
+  for (Expression *&expr : exprs) {
+    expr = expr->fold(context);
+  }
+  return this;
+}
+
+void Definition::fold(FoldContext &context) {
+  if (init) {
+    init = init->fold(context);
+  }
+}
+
+Expression *Let::fold(FoldContext &context) {
+  context.enterScope();
+
+  // Constant variables are replaced by their value, so their definitions
+  // are dropped.
+  std::vector<Definition *> kept;
+  for (Definition *def : defs) {
+    def->fold(context);
+
+    Expression *value = def->getInit();
+    if (!value) {
+      if (def->getType() == Symbol::Int) {
+        value = context.newInteger(def, 0);
+      }
+      else if (def->getType() == Symbol::Bool) {
+        value = context.newBoolean(def, false);
+      }
+      else if (def->getType() == Symbol::String) {
+        value = context.newString(def, "");
+      }
+    }
+
+    // Only a literal of the declared type replaces the variable, see
+    // Conditional::fold
+    if (value && (!isConstant(value) || value->getStaticType() != def->getType())) {
+      value = nullptr;
+    }
+
+    if (!context.define(def->getName(), value)) {
+      kept.push_back(def);
+    }
+  }
+
+  body = body->fold(context);
+
+  context.leaveScope();
+
+  if (kept.empty()) {
+    return body;
+  }
+  defs = std::move(kept);
+  return this;
+}
+
+void Branch::fold(FoldContext &context) {
+  context.enterScope();
+  context.define(name, nullptr);
+  expr = expr->fold(context);
+  context.leaveScope();
+}
+
+Expression *Case::fold(FoldContext &context) {
+  expr = expr->fold(context);
+  for (Branch *branch : branches) {
+    branch->fold(context);
+  }
+  return this;
+}
+
+Expression *New::fold(FoldContext &context) {
+  return this;
+}
+
+Expression *IsVoid::fold(FoldContext &context) {
+  expr = expr->fold(context);
+  if (isConstant(expr)) {
+    return context.newBoolean(this, false);
+  }
+  return this;
+}
+
+Expression *Arithmetic::fold(FoldContext &context) {
+  // Walk the left spine bottom-up like the other passes, folding the
+  // accumulated value of the chain as long as it is constant.
+  std::vector<Arithmetic *> nodes;
+  for (Arithmetic *node = this; node; node = dynamic_cast<Arithmetic *>(node->op1)) {
+    nodes.push_back(node);
+  }
+
+  Expression *acc = nodes.back()->op1->fold(context);
+  for (auto iter = nodes.rbegin(), last = nodes.rend(); iter != last; iter++) {
+    Arithmetic *node = *iter;
+    node->op2 = node->op2->fold(context);
+
+    const Integer *lhs = dynamic_cast<const Integer *>(acc);
+    const Integer *rhs = dynamic_cast<const Integer *>(node->op2);
+    int result;
+    if (lhs && rhs && evaluate(node->op, lhs->getValue(), rhs->getValue(), result)) {
+      acc = context.newInteger(node, result);
+    }
+    else {
+      node->op1 = acc;
+      acc = node;
+    }
+  }
+  return acc;
+}
+
+Expression *Complement::fold(FoldContext &context) {
+  expr = expr->fold(context);
+  const Integer *value = dynamic_cast<const Integer *>(expr);
+  if (value && value->getValue() != INT_MIN) {
+    return context.newInteger(this, -value->getValue());
+  }
+  return this;
+}
+
+Expression *Comparison::fold(FoldContext &context) {
+  op1 = op1->fold(context);
+  op2 = op2->fold(context);
+
+  const Integer *lhs = dynamic_cast<const Integer *>(op1);
+  const Integer *rhs = dynamic_cast<const Integer *>(op2);
+  if (lhs && rhs) {
+    switch (op) {
+      case ComparisonOperator::LT:
+        return context.newBoolean(this, lhs->getValue() < rhs->getValue());
+      case ComparisonOperator::LE:
+        return context.newBoolean(this, lhs->getValue() <= rhs->getValue());
+      case ComparisonOperator::EQ:
+        return context.newBoolean(this, lhs->getValue() == rhs->getValue());
+    }
+  }
+
+  const Boolean *lhsBool = dynamic_cast<const Boolean *>(op1);
+  const Boolean *rhsBool = dynamic_cast<const Boolean *>(op2);
+  if (lhsBool && rhsBool && op == ComparisonOperator::EQ) {
+    return context.newBoolean(this, lhsBool->getValue() == rhsBool->getValue());
+  }
+
+  return this;
+}
+
+Expression *Not::fold(FoldContext &context) {
+  expr = expr->fold(context);
+  if (const Boolean *value = dynamic_cast<const Boolean *>(expr)) {
+    return context.newBoolean(this, !value->getValue());
+  }
+  return this;
+}
+
+Expression *Object::fold(FoldContext &context) {
+  if (Expression *value = context.lookup(name)) {
+    return value;
+  }
+  return this;
+}
+
+Expression *Integer::fold(FoldContext &context) {
+  return this;
+}
+
+Expression *String::fold(FoldContext &context) {
+  return this;
+}
+
+Expression *Boolean::fold(FoldContext &context) {
+  return this;
+}
+
+/**
+ * Fold `expr` in two runs, see `FoldContext`.
+ */
+static Expression *foldBody(Program *program, Expression *expr) {
+  FoldContext context(program);
+  expr = expr->fold(context);
+  context.setPropagate(true);
+  return expr->fold(context);
+}
+
+void fold(const InheritanceTree &inheritanceTree, const std::vector<Program *> &programs) {
+  for (Program *program : programs) {
+    for (Class *claSs : program->getClasses()) {
+      const ClassInfo *classInfo = inheritanceTree.getClassInfo(claSs->getName());
+
+      for (MethodInfo *methodInfo : classInfo->ownMethods) {
+        if (methodInfo->expr) {
+          methodInfo->expr = foldBody(program, methodInfo->expr);
+        }
+      }
+
+      for (const auto &item : classInfo->attributes) {
+        AttributeInfo *attributeInfo = item.second;
+        if (attributeInfo->init) {
+          attributeInfo->init = foldBody(program, attributeInfo->init);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "cool-tree.h"
+#include "cool-type.h"
+
+#include <unordered_set>
+#include <vector>
+
+/**
+ * State of the constant folding pass over the body of one method or attribute
+ * initializer.
+ *
+ * The pass runs twice over each body. The first run folds constant operations
+ * and records the variables that are assigned anywhere in the body, the second
+ * one additionally replaces the `let` variables that are never assigned and
+ * initialized with a constant by that constant.
+ */
+class FoldContext {
+  Program *program;
+  bool propagate;
+  std::unordered_set<Symbol *> assigned;
+  /* Constant value of the variables in scope, `nullptr` for the variables
+   * that are not constant */
+  Symtab<Expression *> constants;
+
+public:
+  explicit FoldContext(Program *program) : program(program), propagate(false) {}
+
+  void setPropagate(bool value) {
+    propagate = value;
+  }
+
+  void enterScope(void) {
+    constants.enterScope();
+  }
+
+  void leaveScope(void) {
+    constants.leaveScope();
+  }
+
+  void addAssigned(Symbol *name) {
+    assigned.insert(name);
+  }
+
+  /**
+   * @brief Bind the variable `name` in the current scope.
+   * @param value the constant initializer of the variable, or `nullptr`.
+   * @return whether the variable is constant, i.e. its uses are replaced by
+   * `value`.
+   */
+  bool define(Symbol *name, Expression *value);
+
+  /**
+   * @return the constant value of the variable `name`, or `nullptr`.
+   */
+  Expression *lookup(Symbol *name) const;
+
+  Expression *newInteger(const TreeNode *origin, int value);
+
+  Expression *newBoolean(const TreeNode *origin, bool value);
+
+  Expression *newString(const TreeNode *origin, const std::string &value);
+};
+
+/**
+ * @brief Fold the constant expressions of the methods and attribute
+ * initializers of the classes of `programs`.
+ *
+ * The folded bodies replace the ones referenced by `inheritanceTree`.
+ */
+void fold(const InheritanceTree &inheritanceTree, const std::vector<Program *> &programs);
@@ -0,0 +1,677 @@
+#include "cool-mips.h"
+
+#include <cctype>
+#include <unordered_map>
+
+static const char *const regNames[] = {
+  "$zero", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+  "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+  "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+  "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra",
+};
+
+static const char *const mnemonics[] = {
+  nullptr,
+  "sll", "srl", "sra", "sllv", "srlv", "srav",
+  "jr", "jalr", "syscall",
+  "mfhi", "mthi", "mflo", "mtlo",
+  "mult", "multu", "div", "divu",
+  "add", "addu", "sub", "subu", "and", "or", "xor", "nor", "slt", "sltu",
+  "j", "jal",
+  "beq", "bne", "blez", "bgtz",
+  "addi", "addiu", "slti", "sltiu", "andi", "ori", "xori", "lui",
+  "lb", "lh", "lw", "lbu", "lhu", "sb", "sh", "sw",
+  "move", "li", "la", "blt", "ble", "bgt", "bge",
+};
+
+static_assert(sizeof(mnemonics) / sizeof(mnemonics[0]) == static_cast<size_t>(Opcode::bge) + 1,
+              "mnemonic table out of sync with Opcode");
+
+const char *regName(Reg reg) {
+  return regNames[static_cast<unsigned int>(reg)];
+}
+
+Reg writtenRegister(const Instruction &instruction) {
+  switch (instruction.opcode) {
+    case Opcode::sll:
+    case Opcode::srl:
+    case Opcode::sra:
+    case Opcode::sllv:
+    case Opcode::srlv:
+    case Opcode::srav:
+    case Opcode::jalr:
+    case Opcode::mfhi:
+    case Opcode::mflo:
+    case Opcode::add:
+    case Opcode::addu:
+    case Opcode::sub:
+    case Opcode::subu:
+    case Opcode::and_:
+    case Opcode::or_:
+    case Opcode::xor_:
+    case Opcode::nor:
+    case Opcode::slt:
+    case Opcode::sltu:
+    case Opcode::move:
+      return instruction.rd;
+    case Opcode::jal:
+      return Reg::ra;
+    case Opcode::addi:
+    case Opcode::addiu:
+    case Opcode::slti:
+    case Opcode::sltiu:
+    case Opcode::andi:
+    case Opcode::ori:
+    case Opcode::xori:
+    case Opcode::lui:
+    case Opcode::lb:
+    case Opcode::lh:
+    case Opcode::lw:
+    case Opcode::lbu:
+    case Opcode::lhu:
+    case Opcode::li:
+    case Opcode::la:
+      return instruction.rt;
+    default:
+      return Reg::zero;
+  }
+}
+
+bool readsRegister(const Instruction &instruction, Reg reg) {
+  switch (instruction.opcode) {
+    case Opcode::sll:
+    case Opcode::srl:
+    case Opcode::sra:
+      return instruction.rt == reg;
+    case Opcode::jr:
+    case Opcode::jalr:
+    case Opcode::mthi:
+    case Opcode::mtlo:
+    case Opcode::blez:
+    case Opcode::bgtz:
+    case Opcode::addi:
+    case Opcode::addiu:
+    case Opcode::slti:
+    case Opcode::sltiu:
+    case Opcode::andi:
+    case Opcode::ori:
+    case Opcode::xori:
+    case Opcode::move:
+      return instruction.rs == reg;
+    case Opcode::lb:
+    case Opcode::lh:
+    case Opcode::lw:
+    case Opcode::lbu:
+    case Opcode::lhu:
+      return instruction.sym == GlobalLabel::none && instruction.rs == reg;
+    case Opcode::sb:
+    case Opcode::sh:
+    case Opcode::sw:
+      return instruction.rt == reg || (instruction.sym == GlobalLabel::none && instruction.rs == reg);
+    case Opcode::sllv:
+    case Opcode::srlv:
+    case Opcode::srav:
+    case Opcode::mult:
+    case Opcode::multu:
+    case Opcode::div:
+    case Opcode::divu:
+    case Opcode::add:
+    case Opcode::addu:
+    case Opcode::sub:
+    case Opcode::subu:
+    case Opcode::and_:
+    case Opcode::or_:
+    case Opcode::xor_:
+    case Opcode::nor:
+    case Opcode::slt:
+    case Opcode::sltu:
+    case Opcode::beq:
+    case Opcode::bne:
+    case Opcode::blt:
+    case Opcode::ble:
+    case Opcode::bgt:
+    case Opcode::bge:
+      return instruction.rs == reg || instruction.rt == reg;
+    default:
+      return false;
+  }
+}
+
+bool isControl(const Instruction &instruction) {
+  switch (instruction.opcode) {
+    case Opcode::label:
+    case Opcode::jr:
+    case Opcode::jalr:
+    case Opcode::syscall:
+    case Opcode::j:
+    case Opcode::jal:
+    case Opcode::beq:
+    case Opcode::bne:
+    case Opcode::blez:
+    case Opcode::bgtz:
+    case Opcode::blt:
+    case Opcode::ble:
+    case Opcode::bgt:
+    case Opcode::bge:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static void printTarget(
+  OutBuffer &out,
+  const Instruction &instruction,
+  const std::vector<std::string> &labelNames,
+  unsigned int labelBase) {
+  if (instruction.sym == GlobalLabel::none) {
+    out << "label" << labelBase + static_cast<unsigned int>(instruction.imm);
+  } else {
+    out << labelNames[static_cast<unsigned int>(instruction.sym)];
+  }
+}
+
+void printInstruction(
+  OutBuffer &out,
+  const Instruction &instruction,
+  const std::vector<std::string> &labelNames,
+  unsigned int labelBase) {
+  if (instruction.opcode == Opcode::label) {
+    printTarget(out, instruction, labelNames, labelBase);
+    out << ":\n";
+    return;
+  }
+
+  out << '\t' << mnemonics[static_cast<unsigned int>(instruction.opcode)];
+
+  const char *rd = regName(instruction.rd);
+  const char *rs = regName(instruction.rs);
+  const char *rt = regName(instruction.rt);
+
+  switch (instruction.opcode) {
+    case Opcode::sll:
+    case Opcode::srl:
+    case Opcode::sra:
+      out << '\t' << rd << ", " << rt << ", " << instruction.imm;
+      break;
+    case Opcode::sllv:
+    case Opcode::srlv:
+    case Opcode::srav:
+      out << '\t' << rd << ", " << rt << ", " << rs;
+      break;
+    case Opcode::jr:
+    case Opcode::mthi:
+    case Opcode::mtlo:
+      out << '\t' << rs;
+      break;
+    case Opcode::jalr:
+      if (instruction.rd == Reg::ra) {
+        out << '\t' << rs;
+      } else {
+        out << '\t' << rd << ", " << rs;
+      }
+      break;
+    case Opcode::syscall:
+      break;
+    case Opcode::mfhi:
+    case Opcode::mflo:
+      out << '\t' << rd;
+      break;
+    case Opcode::mult:
+    case Opcode::multu:
+    case Opcode::div:
+    case Opcode::divu:
+      out << '\t' << rs << ", " << rt;
+      break;
+    case Opcode::add:
+    case Opcode::addu:
+    case Opcode::sub:
+    case Opcode::subu:
+    case Opcode::and_:
+    case Opcode::or_:
+    case Opcode::xor_:
+    case Opcode::nor:
+    case Opcode::slt:
+    case Opcode::sltu:
+      out << '\t' << rd << ", " << rs << ", " << rt;
+      break;
+    case Opcode::j:
+    case Opcode::jal:
+      out << '\t';
+      printTarget(out, instruction, labelNames, labelBase);
+      break;
+    case Opcode::beq:
+    case Opcode::bne:
+    case Opcode::blt:
+    case Opcode::ble:
+    case Opcode::bgt:
+    case Opcode::bge:
+      out << '\t' << rs << ", " << rt << ", ";
+      printTarget(out, instruction, labelNames, labelBase);
+      break;
+    case Opcode::blez:
+    case Opcode::bgtz:
+      out << '\t' << rs << ", ";
+      printTarget(out, instruction, labelNames, labelBase);
+      break;
+    case Opcode::addi:
+    case Opcode::addiu:
+    case Opcode::slti:
+    case Opcode::sltiu:
+    case Opcode::andi:
+    case Opcode::ori:
+    case Opcode::xori:
+      out << '\t' << rt << ", " << rs << ", " << instruction.imm;
+      break;
+    case Opcode::lui:
+    case Opcode::li:
+      out << '\t' << rt << ", " << instruction.imm;
+      break;
+    case Opcode::lb:
+    case Opcode::lh:
+    case Opcode::lw:
+    case Opcode::lbu:
+    case Opcode::lhu:
+    case Opcode::sb:
+    case Opcode::sh:
+    case Opcode::sw:
+      if (instruction.sym == GlobalLabel::none) {
+        out << '\t' << rt << ", " << instruction.imm << '(' << rs << ')';
+      } else {
+        out << '\t' << rt << ", " << labelNames[static_cast<unsigned int>(instruction.sym)];
+      }
+      break;
+    case Opcode::la:
+      out << '\t' << rt << ", " << labelNames[static_cast<unsigned int>(instruction.sym)];
+      break;
+    case Opcode::move:
+      out << '\t' << rd << ", " << rs;
+      break;
+    case Opcode::label:
+      break;
+  }
+
+  out << '\n';
+}
+
+void MethodCode::print(OutBuffer &out, const std::vector<std::string> &labelNames, unsigned int labelBase) const {
+  out << labelNames[static_cast<unsigned int>(name)] << ":\n";
+  for (const Instruction &instruction : instructions) {
+    printInstruction(out, instruction, labelNames, labelBase);
+  }
+}
+
+static unsigned int rtype(Reg rs, Reg rt, Reg rd, unsigned int shamt, unsigned int funct) {
+  return static_cast<unsigned int>(rs) << 21 | static_cast<unsigned int>(rt) << 16 |
+    static_cast<unsigned int>(rd) << 11 | (shamt & 0x1f) << 6 | funct;
+}
+
+static unsigned int itype(unsigned int opcode, Reg rs, Reg rt, int imm) {
+  return opcode << 26 | static_cast<unsigned int>(rs) << 21 | static_cast<unsigned int>(rt) << 16 |
+    (static_cast<unsigned int>(imm) & 0xffff);
+}
+
+static unsigned int jtype(unsigned int opcode, unsigned int target) {
+  return opcode << 26 | (target & 0x3ffffff);
+}
+
+/**
+ * @return the number of machine instructions `instruction` expands to.
+ */
+static unsigned int encodedSize(const Instruction &instruction) {
+  switch (instruction.opcode) {
+    case Opcode::label:
+      return 0;
+    case Opcode::jr:
+    case Opcode::jalr:
+    case Opcode::j:
+    case Opcode::jal:
+    case Opcode::beq:
+    case Opcode::bne:
+    case Opcode::blez:
+    case Opcode::bgtz:
+    case Opcode::la:
+      return 2;
+    case Opcode::lb:
+    case Opcode::lh:
+    case Opcode::lw:
+    case Opcode::lbu:
+    case Opcode::lhu:
+    case Opcode::sb:
+    case Opcode::sh:
+    case Opcode::sw:
+      return instruction.sym == GlobalLabel::none ? 1 : 2;
+    case Opcode::blt:
+    case Opcode::ble:
+    case Opcode::bgt:
+    case Opcode::bge:
+      return 3;
+    default:
+      return 1;
+  }
+}
+
+bool MethodCode::encode(MachineCode &code) const {
+  static const unsigned int nop = 0;
+
+  unsigned int start = static_cast<unsigned int>(code.bytes.size());
+
+  // Local labels may be referenced before they are defined, so locate them
+  // first.
+  std::unordered_map<int, unsigned int> labels;
+  unsigned int offset = start;
+  for (const Instruction &instruction : instructions) {
+    if (instruction.opcode == Opcode::label && instruction.sym == GlobalLabel::none) {
+      labels[instruction.imm] = offset;
+    }
+    offset += encodedSize(instruction) * 4;
+  }
+
+  code.definitions.push_back({ name, start });
+
+  bool reachable = true;
+  auto branch = [&] (unsigned int opcode, Reg rs, Reg rt, int label) {
+    int distance = static_cast<int>(labels[label]) - static_cast<int>(code.bytes.size() + 4);
+    if (distance < -0x20000 || distance >= 0x20000) {
+      reachable = false;
+    }
+    code.emit_word(itype(opcode, rs, rt, distance / 4));
+    code.emit_word(nop);
+  };
+
+  for (const Instruction &instruction : instructions) {
+    unsigned int pc = static_cast<unsigned int>(code.bytes.size());
+    Reg rd = instruction.rd;
+    Reg rs = instruction.rs;
+    Reg rt = instruction.rt;
+    int imm = instruction.imm;
+
+    switch (instruction.opcode) {
+      case Opcode::label:
+        if (instruction.sym != GlobalLabel::none) {
+          code.definitions.push_back({ instruction.sym, pc });
+        }
+        break;
+      case Opcode::sll:
+        code.emit_word(rtype(Reg::zero, rt, rd, imm, 0));
+        break;
+      case Opcode::srl:
+        code.emit_word(rtype(Reg::zero, rt, rd, imm, 2));
+        break;
+      case Opcode::sra:
+        code.emit_word(rtype(Reg::zero, rt, rd, imm, 3));
+        break;
+      case Opcode::sllv:
+        code.emit_word(rtype(rs, rt, rd, 0, 4));
+        break;
+      case Opcode::srlv:
+        code.emit_word(rtype(rs, rt, rd, 0, 6));
+        break;
+      case Opcode::srav:
+        code.emit_word(rtype(rs, rt, rd, 0, 7));
+        break;
+      case Opcode::jr:
+        code.emit_word(rtype(rs, Reg::zero, Reg::zero, 0, 8));
+        code.emit_word(nop);
+        break;
+      case Opcode::jalr:
+        code.emit_word(rtype(rs, Reg::zero, rd, 0, 9));
+        code.emit_word(nop);
+        break;
+      case Opcode::syscall:
+        code.emit_word(12);
+        break;
+      case Opcode::mfhi:
+        code.emit_word(rtype(Reg::zero, Reg::zero, rd, 0, 16));
+        break;
+      case Opcode::mthi:
+        code.emit_word(rtype(rs, Reg::zero, Reg::zero, 0, 17));
+        break;
+      case Opcode::mflo:
+        code.emit_word(rtype(Reg::zero, Reg::zero, rd, 0, 18));
+        break;
+      case Opcode::mtlo:
+        code.emit_word(rtype(rs, Reg::zero, Reg::zero, 0, 19));
+        break;
+      case Opcode::mult:
+        code.emit_word(rtype(rs, rt, Reg::zero, 0, 24));
+        break;
+      case Opcode::multu:
+        code.emit_word(rtype(rs, rt, Reg::zero, 0, 25));
+        break;
+      case Opcode::div:
+        code.emit_word(rtype(rs, rt, Reg::zero, 0, 26));
+        break;
+      case Opcode::divu:
+        code.emit_word(rtype(rs, rt, Reg::zero, 0, 27));
+        break;
+      case Opcode::add:
+        code.emit_word(rtype(rs, rt, rd, 0, 32));
+        break;
+      case Opcode::addu:
+        code.emit_word(rtype(rs, rt, rd, 0, 33));
+        break;
+      case Opcode::sub:
+        code.emit_word(rtype(rs, rt, rd, 0, 34));
+        break;
+      case Opcode::subu:
+        code.emit_word(rtype(rs, rt, rd, 0, 35));
+        break;
+      case Opcode::and_:
+        code.emit_word(rtype(rs, rt, rd, 0, 36));
+        break;
+      case Opcode::or_:
+        code.emit_word(rtype(rs, rt, rd, 0, 37));
+        break;
+      case Opcode::xor_:
+        code.emit_word(rtype(rs, rt, rd, 0, 38));
+        break;
+      case Opcode::nor:
+        code.emit_word(rtype(rs, rt, rd, 0, 39));
+        break;
+      case Opcode::slt:
+        code.emit_word(rtype(rs, rt, rd, 0, 42));
+        break;
+      case Opcode::sltu:
+        code.emit_word(rtype(rs, rt, rd, 0, 43));
+        break;
+      case Opcode::j:
+      case Opcode::jal: {
+        unsigned int opcode = instruction.opcode == Opcode::j ? 2 : 3;
+        code.fixups.push_back({ pc, instruction.sym, Relocation::jump26 });
+        if (instruction.sym == GlobalLabel::none) {
+          code.emit_word(jtype(opcode, labels[imm] >> 2));
+        } else {
+          code.emit_word(jtype(opcode, 0));
+        }
+        code.emit_word(nop);
+        break;
+      }
+      case Opcode::beq:
+        branch(4, rs, rt, imm);
+        break;
+      case Opcode::bne:
+        branch(5, rs, rt, imm);
+        break;
+      case Opcode::blez:
+        branch(6, rs, Reg::zero, imm);
+        break;
+      case Opcode::bgtz:
+        branch(7, rs, Reg::zero, imm);
+        break;
+      case Opcode::addi:
+        code.emit_word(itype(8, rs, rt, imm));
+        break;
+      case Opcode::addiu:
+        code.emit_word(itype(9, rs, rt, imm));
+        break;
+      case Opcode::slti:
+        code.emit_word(itype(10, rs, rt, imm));
+        break;
+      case Opcode::sltiu:
+        code.emit_word(itype(11, rs, rt, imm));
+        break;
+      case Opcode::andi:
+        code.emit_word(itype(12, rs, rt, imm));
+        break;
+      case Opcode::ori:
+        code.emit_word(itype(13, rs, rt, imm));
+        break;
+      case Opcode::xori:
+        code.emit_word(itype(14, rs, rt, imm));
+        break;
+      case Opcode::lui:
+        code.emit_word(itype(15, Reg::zero, rt, imm));
+        break;
+      case Opcode::lb:
+      case Opcode::lh:
+      case Opcode::lw:
+      case Opcode::lbu:
+      case Opcode::lhu:
+      case Opcode::sb:
+      case Opcode::sh:
+      case Opcode::sw: {
+        static const unsigned int opcodes[] = { 32, 33, 35, 36, 37, 40, 41, 43 };
+        unsigned int opcode = opcodes[static_cast<unsigned int>(instruction.opcode) - static_cast<unsigned int>(Opcode::lb)];
+        if (instruction.sym == GlobalLabel::none) {
+          code.emit_word(itype(opcode, rs, rt, imm));
+        } else {
+          code.fixups.push_back({ pc, instruction.sym, Relocation::hi16 });
+          code.emit_word(itype(15, Reg::zero, Reg::at, 0));
+          code.fixups.push_back({ pc + 4, instruction.sym, Relocation::lo16 });
+          code.emit_word(itype(opcode, Reg::at, rt, 0));
+        }
+        break;
+      }
+      case Opcode::move:
+        code.emit_word(rtype(rs, Reg::zero, rd, 0, 33));
+        break;
+      case Opcode::li:
+        code.emit_word(itype(9, Reg::zero, rt, imm));
+        break;
+      case Opcode::la:
+        code.fixups.push_back({ pc, instruction.sym, Relocation::hi16 });
+        code.emit_word(itype(15, Reg::zero, rt, 0));
+        code.fixups.push_back({ pc + 4, instruction.sym, Relocation::lo16 });
+        code.emit_word(itype(9, rt, rt, 0));
+        break;
+      case Opcode::blt:
+        code.emit_word(rtype(rs, rt, Reg::at, 0, 42));
+        branch(5, Reg::at, Reg::zero, imm);
+        break;
+      case Opcode::bge:
+        code.emit_word(rtype(rs, rt, Reg::at, 0, 42));
+        branch(4, Reg::at, Reg::zero, imm);
+        break;
+      case Opcode::bgt:
+        code.emit_word(rtype(rt, rs, Reg::at, 0, 42));
+        branch(5, Reg::at, Reg::zero, imm);
+        break;
+      case Opcode::ble:
+        code.emit_word(rtype(rt, rs, Reg::at, 0, 42));
+        branch(4, Reg::at, Reg::zero, imm);
+        break;
+    }
+  }
+
+  return reachable;
+}
+
+void printDataItem(OutBuffer &out, const DataItem &item, const std::vector<std::string> &labelNames) {
+  static const char *digits = "0123456789abcdef";
+
+  switch (item.op) {
+    case DataOp::label:
+      out << labelNames[static_cast<unsigned int>(item.sym)] << ":\n";
+      break;
+    case DataOp::align:
+      out << "\t.align\t" << item.value << '\n';
+      break;
+    case DataOp::word:
+      if (item.sym == GlobalLabel::none) {
+        out << "\t.word\t" << item.value << '\n';
+      } else {
+        out << "\t.word\t" << labelNames[static_cast<unsigned int>(item.sym)] << '\n';
+      }
+      break;
+    case DataOp::byte:
+      out << "\t.byte\t" << item.value << '\n';
+      break;
+    case DataOp::ascii:
+      out << "\t.ascii\t\"";
+      for (unsigned char c : item.text) {
+        switch (c) {
+          case '\0':
+            out << "\\0";
+            break;
+          case '\a':
+            out << "\\a";
+            break;
+          case '\b':
+            out << "\\b";
+            break;
+          case '\t':
+            out << "\\t";
+            break;
+          case '\v':
+            out << "\\v";
+            break;
+          case '\f':
+            out << "\\f";
+            break;
+          case '\n':
+            out << "\\n";
+            break;
+          case '\r':
+            out << "\\r";
+            break;
+          case '"':
+            out << "\\\"";
+            break;
+          case '\\':
+            out << "\\\\";
+            break;
+          default:
+            if (std::isprint(c)) {
+              out << static_cast<char>(c);
+            }
+            else {
+              out << "\\x" << digits[c / 16] << digits[c % 16];
+            }
+            break;
+        }
+      }
+      out << "\"\n";
+      break;
+  }
+}
+
+void encodeData(const std::vector<DataItem> &items, MachineCode &code) {
+  for (const DataItem &item : items) {
+    unsigned int offset = static_cast<unsigned int>(code.bytes.size());
+    switch (item.op) {
+      case DataOp::label:
+        code.definitions.push_back({ item.sym, offset });
+        break;
+      case DataOp::align:
+        while (code.bytes.size() % (1u << item.value) != 0) {
+          code.bytes.push_back(0);
+        }
+        break;
+      case DataOp::word:
+        if (item.sym == GlobalLabel::none) {
+          code.emit_word(static_cast<unsigned int>(item.value));
+        } else {
+          code.fixups.push_back({ offset, item.sym, Relocation::word32 });
+          code.emit_word(0);
+        }
+        break;
+      case DataOp::byte:
+        code.bytes.push_back(static_cast<unsigned char>(item.value));
+        break;
+      case DataOp::ascii:
+        code.bytes.insert(code.bytes.end(), item.text.begin(), item.text.end());
+        break;
+    }
+  }
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "outbuf.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * MIPS general-purpose registers, numbered as in the instruction encoding.
+ */
+enum class Reg : unsigned char {
+  zero, at, v0, v1, a0, a1, a2, a3,
+  t0, t1, t2, t3, t4, t5, t6, t7,
+  s0, s1, s2, s3, s4, s5, s6, s7,
+  t8, t9, k0, k1, gp, sp, fp, ra,
+};
+
+/**
+ * @return the assembler name of `reg`, e.g. "$a0".
+ */
+const char *regName(Reg reg);
+
+/**
+ * Id of a global (named) label. Local labels are plain integers and printed as
+ * `label<N>`.
+ */
+enum class GlobalLabel : unsigned int {
+  none = 0,
+};
+
+enum class Opcode : unsigned char {
+  /* Definition of the local label `imm`, or of the global label `sym` if it
+   * is set */
+  label,
+
+  /* R-type instructions */
+  sll, srl, sra, sllv, srlv, srav,
+  jr, jalr, syscall,
+  mfhi, mthi, mflo, mtlo,
+  mult, multu, div, divu,
+  add, addu, sub, subu, and_, or_, xor_, nor, slt, sltu,
+
+  /* J-type instructions */
+  j, jal,
+
+  /* I-type instructions */
+  beq, bne, blez, bgtz,
+  addi, addiu, slti, sltiu, andi, ori, xori, lui,
+  lb, lh, lw, lbu, lhu, sb, sh, sw,
+
+  /* Pseudo-instructions */
+  move, li, la, blt, ble, bgt, bge,
+};
+
+/**
+ * A single machine instruction.
+ *
+ * Register fields follow the MIPS encoding: `rd` is the destination of R-type
+ * instructions and `rt` the destination of I-type instructions and loads.
+ * Fields an opcode does not use are left as `Reg::zero`.
+ *
+ * Jumps and branches either target the local label `imm` or, when `sym` is set,
+ * the global label `sym`. Loads and `la` address the data label `sym` when it
+ * is set, and `imm(rs)` otherwise.
+ */
+struct Instruction {
+  Opcode opcode;
+  Reg rd;
+  Reg rs;
+  Reg rt;
+  int imm;
+  GlobalLabel sym;
+};
+
+/**
+ * @return the general-purpose register written by `instruction`, `Reg::zero`
+ * if there is none. Calls only report `$ra` here, the registers clobbered by the
+ * callee are not known.
+ */
+Reg writtenRegister(const Instruction &instruction);
+
+/**
+ * @return whether `instruction` reads the register `reg`.
+ */
+bool readsRegister(const Instruction &instruction, Reg reg);
+
+/**
+ * @return whether `instruction` is a label, jump, branch or call, i.e. may
+ * transfer control or be the target of a transfer.
+ */
+bool isControl(const Instruction &instruction);
+
+/**
+ * Relocation types, numbered as in the MIPS ELF ABI (R_MIPS_*).
+ */
+enum class Relocation : unsigned char {
+  word32 = 2,
+  jump26 = 4,
+  hi16 = 5,
+  lo16 = 6,
+};
+
+/**
+ * Encoded machine code or data, relative to its own start.
+ */
+struct MachineCode {
+  struct Fixup {
+    unsigned int offset;
+    /* Referenced label; `GlobalLabel::none` for a reference to the code itself,
+     * whose encoded addend is relative to the start of `bytes` */
+    GlobalLabel sym;
+    Relocation type;
+  };
+
+  std::vector<unsigned char> bytes;
+  std::vector<Fixup> fixups;
+  /* Global labels defined in the code, with their offsets */
+  std::vector<std::pair<GlobalLabel, unsigned int>> definitions;
+
+  void emit_word(unsigned int word) {
+    bytes.push_back(static_cast<unsigned char>(word));
+    bytes.push_back(static_cast<unsigned char>(word >> 8));
+    bytes.push_back(static_cast<unsigned char>(word >> 16));
+    bytes.push_back(static_cast<unsigned char>(word >> 24));
+  }
+};
+
+/**
+ * The instructions of one method (or class initializer), in program order.
+ */
+struct MethodCode {
+  GlobalLabel name;
+  std::vector<Instruction> instructions;
+
+  MethodCode(void) : name(GlobalLabel::none) {}
+
+  void clear(void) {
+    name = GlobalLabel::none;
+    instructions.clear();
+  }
+
+  /**
+   * @brief Print the method in SPIM syntax, starting with its global label.
+   * @param labelNames the names of the global labels, indexed by id.
+   * @param labelBase number added to local label ids.
+   */
+  void print(OutBuffer &out, const std::vector<std::string> &labelNames, unsigned int labelBase) const;
+
+  /**
+   * @brief Append the method to `code` as little-endian MIPS32 machine code.
+   *
+   * Pseudo-instructions are expanded using `$at`, and a `nop` fills the delay
+   * slot of every jump and branch.
+   *
+   * @return false if a branch does not reach its target.
+   */
+  bool encode(MachineCode &code) const;
+};
+
+void printInstruction(
+  OutBuffer &out,
+  const Instruction &instruction,
+  const std::vector<std::string> &labelNames,
+  unsigned int labelBase);
+
+enum class DataOp : unsigned char {
+  /* Definition of the global label `sym` */
+  label,
+  /* Alignment to 2^`value` bytes */
+  align,
+  /* Word holding the address of `sym`, or `value` if `sym` is not set */
+  word,
+  byte,
+  ascii,
+};
+
+/**
+ * A single item of the data section.
+ */
+struct DataItem {
+  DataOp op;
+  int value;
+  GlobalLabel sym;
+  std::string text;
+};
+
+void printDataItem(OutBuffer &out, const DataItem &item, const std::vector<std::string> &labelNames);
+
+/**
+ * @brief Append the data items to `code`.
+ */
+void encodeData(const std::vector<DataItem> &items, MachineCode &code);
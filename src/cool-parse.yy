@@ -194,7 +194,7 @@ Expression:
       $$ = program->new_tree_node<Dispatch>(@$, $1, $3, nullptr, $5);
     }
   | Expression '@' TYPEID '.' OBJECTID '(' OptionalExpressions ')' {
-      $$ = program->new_tree_node<Dispatch>(@$, $1, $3, $5, $7);
+      $$ = program->new_tree_node<Dispatch>(@$, $1, $5, $3, $7);
     }
   | OBJECTID '(' OptionalExpressions ')' {
       $$ = program->new_tree_node<Dispatch>(@$, nullptr, $1, nullptr, $3);
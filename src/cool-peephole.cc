@@ -0,0 +1,270 @@
+#include "cool-peephole.h"
+
+/**
+ * A rewrite rule over `window` consecutive instructions. `rewrite` appends the
+ * replacement of the window to `out` and returns true, or leaves `out` alone
+ * and returns false if the rule does not apply.
+ */
+struct PeepholeRule {
+  const char *name;
+  size_t window;
+  bool (*rewrite)(const Instruction *in, std::vector<Instruction> &out);
+};
+
+static Instruction makeMove(Reg dst, Reg src) {
+  return { Opcode::move, dst, src, Reg::zero, 0, GlobalLabel::none };
+}
+
+static bool isStackAdjust(const Instruction &instruction, int amount) {
+  return instruction.opcode == Opcode::addiu &&
+    instruction.rt == Reg::sp &&
+    instruction.rs == Reg::sp &&
+    instruction.imm == amount;
+}
+
+static bool isStackAccess(const Instruction &instruction, Opcode opcode) {
+  return instruction.opcode == opcode &&
+    instruction.sym == GlobalLabel::none &&
+    instruction.rs == Reg::sp &&
+    instruction.imm == 0;
+}
+
+/**
+ * `sw R, 0($sp); addiu $sp, $sp, -4` pushes R.
+ */
+static bool isPush(const Instruction *in) {
+  return isStackAccess(in[0], Opcode::sw) && isStackAdjust(in[1], -4);
+}
+
+/**
+ * `addiu $sp, $sp, 4; lw S, 0($sp)` pops into S.
+ */
+static bool isPop(const Instruction *in) {
+  return isStackAdjust(in[0], 4) && isStackAccess(in[1], Opcode::lw);
+}
+
+/**
+ * push R; pop S => move S, R
+ */
+static bool rewritePushPop(const Instruction *in, std::vector<Instruction> &out) {
+  if (!isPush(in) || !isPop(in + 2)) {
+    return false;
+  }
+
+  if (in[3].rt != in[0].rt) {
+    out.push_back(makeMove(in[3].rt, in[0].rt));
+  }
+  return true;
+}
+
+/**
+ * push R; X; pop S => move S, R; X
+ *
+ * X may overwrite R, but it must neither touch S nor the stack pointer.
+ */
+static bool rewritePushOpPop(const Instruction *in, std::vector<Instruction> &out) {
+  if (!isPush(in) || !isPop(in + 3)) {
+    return false;
+  }
+
+  const Instruction &op = in[2];
+  Reg src = in[0].rt;
+  Reg dst = in[4].rt;
+  if (isControl(op) ||
+      readsRegister(op, Reg::sp) || writtenRegister(op) == Reg::sp ||
+      readsRegister(op, dst) || writtenRegister(op) == dst) {
+    return false;
+  }
+
+  if (dst != src) {
+    out.push_back(makeMove(dst, src));
+  }
+  out.push_back(op);
+  return true;
+}
+
+/**
+ * sw R, off(B); lw S, off(B) => sw R, off(B); move S, R
+ */
+static bool rewriteStoreLoad(const Instruction *in, std::vector<Instruction> &out) {
+  const Instruction &store = in[0];
+  const Instruction &load = in[1];
+  if (store.opcode != Opcode::sw || load.opcode != Opcode::lw ||
+      store.rs != load.rs || store.imm != load.imm || store.sym != load.sym) {
+    return false;
+  }
+
+  out.push_back(store);
+  if (load.rt != store.rt) {
+    out.push_back(makeMove(load.rt, store.rt));
+  }
+  return true;
+}
+
+/**
+ * addiu R, R, a; addiu R, R, b => addiu R, R, a + b
+ */
+static bool rewriteAdjacentAddiu(const Instruction *in, std::vector<Instruction> &out) {
+  if (in[0].opcode != Opcode::addiu || in[0].rs != in[0].rt ||
+      in[1].opcode != Opcode::addiu || in[1].rs != in[1].rt ||
+      in[0].rt != in[1].rt) {
+    return false;
+  }
+
+  int sum = in[0].imm + in[1].imm;
+  if (sum < -0x8000 || sum > 0x7fff) {
+    return false;
+  }
+
+  if (sum != 0) {
+    Instruction instruction = in[0];
+    instruction.imm = sum;
+    out.push_back(instruction);
+  }
+  return true;
+}
+
+/**
+ * @return whether `instruction` only sets a register from a register, a
+ * constant or memory, without any other effect.
+ */
+static bool isSimpleDefinition(const Instruction &instruction) {
+  switch (instruction.opcode) {
+    case Opcode::move:
+    case Opcode::li:
+    case Opcode::la:
+    case Opcode::lw:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static void setDestination(Instruction &instruction, Reg reg) {
+  if (instruction.opcode == Opcode::move) {
+    instruction.rd = reg;
+  }
+  else {
+    instruction.rt = reg;
+  }
+}
+
+/**
+ * X writes R; Y overwrites R without reading it => Y
+ */
+static bool rewriteDeadDefinition(const Instruction *in, std::vector<Instruction> &out) {
+  if (!isSimpleDefinition(in[0]) || isControl(in[1])) {
+    return false;
+  }
+
+  Reg reg = writtenRegister(in[0]);
+  if (writtenRegister(in[1]) != reg || readsRegister(in[1], reg)) {
+    return false;
+  }
+
+  out.push_back(in[1]);
+  return true;
+}
+
+/**
+ * X writes R; move S, R; Y overwrites R without reading it => X writes S; Y
+ */
+static bool rewriteForwardCopy(const Instruction *in, std::vector<Instruction> &out) {
+  if (!isSimpleDefinition(in[0]) || in[1].opcode != Opcode::move || isControl(in[2])) {
+    return false;
+  }
+
+  Reg reg = writtenRegister(in[0]);
+  if (in[1].rs != reg || in[1].rd == reg || writtenRegister(in[2]) != reg || readsRegister(in[2], reg)) {
+    return false;
+  }
+
+  Instruction instruction = in[0];
+  setDestination(instruction, in[1].rd);
+  out.push_back(instruction);
+  out.push_back(in[2]);
+  return true;
+}
+
+/**
+ * j labelN; labelN: => labelN:
+ */
+static bool rewriteJumpToNext(const Instruction *in, std::vector<Instruction> &out) {
+  if (in[0].opcode != Opcode::j || in[0].sym != GlobalLabel::none ||
+      in[1].opcode != Opcode::label || in[1].sym != GlobalLabel::none || in[1].imm != in[0].imm) {
+    return false;
+  }
+
+  out.push_back(in[1]);
+  return true;
+}
+
+/**
+ * move R, R =>
+ */
+static bool rewriteSelfMove(const Instruction *in, std::vector<Instruction> &out) {
+  return in[0].opcode == Opcode::move && in[0].rd == in[0].rs;
+}
+
+/* Tried in order at every position, so wider windows come first */
+static const PeepholeRule rules[] = {
+  { "push-op-pop", 5, rewritePushOpPop },
+  { "push-pop", 4, rewritePushPop },
+  { "forward-copy", 3, rewriteForwardCopy },
+  { "store-load", 2, rewriteStoreLoad },
+  { "adjacent-addiu", 2, rewriteAdjacentAddiu },
+  { "dead-definition", 2, rewriteDeadDefinition },
+  { "jump-to-next", 2, rewriteJumpToNext },
+  { "self-move", 1, rewriteSelfMove },
+};
+
+static const size_t RULE_COUNT = sizeof(rules) / sizeof(rules[0]);
+
+PeepholeStats::PeepholeStats(void) : hits(RULE_COUNT, 0) {}
+
+void PeepholeStats::add(const PeepholeStats &other) {
+  for (size_t i = 0; i < RULE_COUNT; i++) {
+    hits[i] += other.hits[i];
+  }
+}
+
+void PeepholeStats::print(std::ostream &out) const {
+  for (size_t i = 0; i < RULE_COUNT; i++) {
+    out << "peephole " << rules[i].name << ": " << hits[i] << std::endl;
+  }
+}
+
+void peephole(MethodCode &code, PeepholeStats &stats) {
+  std::vector<Instruction> out;
+
+  // A rewrite may expose another one across the boundary of its window, so
+  // repeat until nothing changes.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    const std::vector<Instruction> &in = code.instructions;
+    out.clear();
+    out.reserve(in.size());
+
+    size_t i = 0;
+    size_t n = in.size();
+    while (i < n) {
+      size_t rule = 0;
+      while (rule < RULE_COUNT && !(i + rules[rule].window <= n && rules[rule].rewrite(&in[i], out))) {
+        rule++;
+      }
+
+      if (rule < RULE_COUNT) {
+        stats.hit(rule);
+        i += rules[rule].window;
+        changed = true;
+      }
+      else {
+        out.push_back(in[i++]);
+      }
+    }
+
+    code.instructions.swap(out);
+  }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "cool-mips.h"
+
+#include <ostream>
+#include <vector>
+
+/**
+ * Number of times each peephole rule was applied, indexed like the rule
+ * table in cool-peephole.cc.
+ */
+class PeepholeStats {
+  std::vector<unsigned long> hits;
+
+public:
+  PeepholeStats(void);
+
+  void hit(size_t rule) {
+    hits[rule]++;
+  }
+
+  void add(const PeepholeStats &other);
+
+  /**
+   * @brief Print one line per rule, with its name and hit count.
+   */
+  void print(std::ostream &out) const;
+};
+
+/**
+ * @brief Rewrite redundant instruction sequences of `code` left behind by the
+ * stack machine, until no rule applies anymore.
+ *
+ * The rules look at a small window of consecutive instructions. A window never
+ * extends across a label or a jump unless the rule is about that label or jump
+ * itself, so the rewrites are local to straight-line code.
+ */
+void peephole(MethodCode &code, PeepholeStats &stats);
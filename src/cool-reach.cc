@@ -0,0 +1,190 @@
+#include "cool-reach.h"
+
+ReachContext::ReachContext(const InheritanceTree &inheritanceTree)
+  : inheritanceTree(inheritanceTree), currentType(nullptr) {
+  // The runtime creates the objects of the basic classes, and the program
+  // starts with `Main.main` on a new Main object.
+  Symbol *Main = strtab.new_string("Main");
+  for (Symbol *typeName : { Symbol::Object, Symbol::IO, Symbol::Int, Symbol::String, Symbol::Bool, Main }) {
+    instantiate(typeName);
+  }
+  staticDispatch(Main, strtab.new_string("main"));
+
+  while (!pending.empty()) {
+    std::pair<const Expression *, Symbol *> item = pending.back();
+    pending.pop_back();
+    currentType = item.second;
+    item.first->reach(*this);
+  }
+}
+
+void ReachContext::initialize(const ClassInfo *classInfo) {
+  for (; classInfo && initialized.insert(classInfo).second; classInfo = classInfo->base) {
+    for (const auto &item : classInfo->attributes) {
+      if (item.second->init) {
+        pending.push_back({ item.second->init, classInfo->typeName });
+      }
+    }
+  }
+}
+
+void ReachContext::call(const MethodInfo *methodInfo) {
+  if (methodInfo && methods.insert(methodInfo).second && methodInfo->expr) {
+    pending.push_back({ methodInfo->expr, methodInfo->typeName });
+  }
+}
+
+void ReachContext::instantiate(Symbol *typeName) {
+  const ClassInfo *classInfo = inheritanceTree.getClassInfo(typeName);
+  if (!classInfo || !instantiated.insert(classInfo).second) {
+    return;
+  }
+  initialize(classInfo);
+
+  for (const auto &item : dispatches) {
+    const ClassInfo *staticInfo = inheritanceTree.getClassInfo(item.first);
+    if (classInfo->tag >= staticInfo->tag && classInfo->tag < staticInfo->tagEnd) {
+      call(inheritanceTree.getMethodInfo(typeName, item.second));
+    }
+  }
+}
+
+void ReachContext::dispatch(Symbol *typeName, Symbol *methName) {
+  if (!dispatches.insert({ typeName, methName }).second) {
+    return;
+  }
+
+  const ClassInfo *staticInfo = inheritanceTree.getClassInfo(typeName);
+  for (const ClassInfo *classInfo : instantiated) {
+    if (classInfo->tag >= staticInfo->tag && classInfo->tag < staticInfo->tagEnd) {
+      call(inheritanceTree.getMethodInfo(classInfo->typeName, methName));
+    }
+  }
+}
+
+void ReachContext::staticDispatch(Symbol *typeName, Symbol *methName) {
+  call(inheritanceTree.getMethodInfo(typeName, methName));
+}
+
+void ReachContext::print(std::ostream &out) const {
+  unsigned long allMethods = 0;
+  unsigned long reachable = 0;
+  for (const ClassInfo *classInfo : inheritanceTree.getClasses()) {
+    for (const MethodInfo *methodInfo : classInfo->ownMethods) {
+      if (methodInfo->expr) {
+        allMethods++;
+        reachable += isReachable(methodInfo) ? 1 : 0;
+      }
+    }
+  }
+
+  out << "reachable methods: " << reachable << " of " << allMethods << std::endl;
+  out << "instantiated classes: " << instantiated.size() << " of " << inheritanceTree.getClasses().size() << std::endl;
+}
+
+void Assign::reach(ReachContext &context) const {
+  expr->reach(context);
+}
+
+void Dispatch::reach(ReachContext &context) const {
+  for (Expression *arg : args) {
+    arg->reach(context);
+  }
+
+  Symbol *dispatchType = context.getCurrentType();
+  if (expr) {
+    expr->reach(context);
+    if (expr->getStaticType() != Symbol::SELF_TYPE) {
+      dispatchType = expr->getStaticType();
+    }
+  }
+
+  if (type) {
+    context.staticDispatch(type, name);
+  }
+  else {
+    context.dispatch(dispatchType, name);
+  }
+}
+
+void Conditional::reach(ReachContext &context) const {
+  pred->reach(context);
+  then->reach(context);
+  elSe->reach(context);
+}
+
+void Loop::reach(ReachContext &context) const {
+  pred->reach(context);
+  body->reach(context);
+}
+
+void Block::reach(ReachContext &context) const {
+  for (Expression *expr : exprs) {
+    expr->reach(context);
+  }
+}
+
+void Definition::reach(ReachContext &context) const {
+  if (init) {
+    init->reach(context);
+  }
+}
+
+void Let::reach(ReachContext &context) const {
+  for (Definition *def : defs) {
+    def->reach(context);
+  }
+  body->reach(context);
+}
+
+void Branch::reach(ReachContext &context) const {
+  expr->reach(context);
+}
+
+void Case::reach(ReachContext &context) const {
+  expr->reach(context);
+  for (Branch *branch : branches) {
+    branch->reach(context);
+  }
+}
+
+void New::reach(ReachContext &context) const {
+  // SELF_TYPE creates an object of the class of self, which is instantiated
+  // already
+  if (type != Symbol::SELF_TYPE) {
+    context.instantiate(type);
+  }
+}
+
+void IsVoid::reach(ReachContext &context) const {
+  expr->reach(context);
+}
+
+void Arithmetic::reach(ReachContext &context) const {
+  std::vector<const Arithmetic *> nodes = spine();
+  nodes.back()->op1->reach(context);
+  for (const Arithmetic *node : nodes) {
+    node->op2->reach(context);
+  }
+}
+
+void Complement::reach(ReachContext &context) const {
+  expr->reach(context);
+}
+
+void Comparison::reach(ReachContext &context) const {
+  op1->reach(context);
+  op2->reach(context);
+}
+
+void Not::reach(ReachContext &context) const {
+  expr->reach(context);
+}
+
+void Object::reach(ReachContext &context) const {}
+
+void Integer::reach(ReachContext &context) const {}
+
+void String::reach(ReachContext &context) const {}
+
+void Boolean::reach(ReachContext &context) const {}
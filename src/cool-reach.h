@@ -0,0 +1,91 @@
+#pragma once
+
+#include "cool-tree.h"
+#include "cool-type.h"
+
+#include <ostream>
+#include <set>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/**
+ * Whole-program reachability analysis: the classes that may be instantiated
+ * and the methods that may be called when the program runs, starting from
+ * `Main.main`.
+ *
+ * A dynamic dispatch on the static type T reaches the definition of the method
+ * seen by each instantiated class conforming to T, so the dispatches visited
+ * so far are revisited each time a class gets instantiated. A static dispatch
+ * reaches its definition whatever the receiver.
+ */
+class ReachContext {
+  const InheritanceTree &inheritanceTree;
+  /* Class defining the body being visited */
+  Symbol *currentType;
+
+  std::unordered_set<const ClassInfo *> instantiated;
+  /* Classes whose initialization method runs: the instantiated classes and
+   * their ancestors */
+  std::unordered_set<const ClassInfo *> initialized;
+  std::unordered_set<const MethodInfo *> methods;
+
+  /* (static type, method) of the dynamic dispatches visited so far */
+  std::set<std::pair<Symbol *, Symbol *>> dispatches;
+
+  /* Bodies left to visit, with the class defining them */
+  std::vector<std::pair<const Expression *, Symbol *>> pending;
+
+  void initialize(const ClassInfo *classInfo);
+
+  void call(const MethodInfo *methodInfo);
+
+public:
+  /**
+   * @brief Run the analysis over the program of `inheritanceTree`, after
+   * `InheritanceTree::fix`.
+   */
+  explicit ReachContext(const InheritanceTree &inheritanceTree);
+
+  Symbol *getCurrentType(void) const {
+    return currentType;
+  }
+
+  /**
+   * @brief Record an object of the class `typeName` being created.
+   */
+  void instantiate(Symbol *typeName);
+
+  /**
+   * @brief Record a dynamic dispatch of `methName` on an object of static
+   * type `typeName`.
+   */
+  void dispatch(Symbol *typeName, Symbol *methName);
+
+  /**
+   * @brief Record a static dispatch to the definition of `methName` seen by
+   * `typeName`.
+   */
+  void staticDispatch(Symbol *typeName, Symbol *methName);
+
+  const std::unordered_set<const ClassInfo *> &getInstantiated(void) const {
+    return instantiated;
+  }
+
+  bool isInstantiated(const ClassInfo *classInfo) const {
+    return instantiated.count(classInfo) != 0;
+  }
+
+  bool isInitialized(const ClassInfo *classInfo) const {
+    return initialized.count(classInfo) != 0;
+  }
+
+  bool isReachable(const MethodInfo *methodInfo) const {
+    return methods.count(methodInfo) != 0;
+  }
+
+  /**
+   * @brief Print the number of reachable methods and instantiated classes.
+   */
+  void print(std::ostream &out) const;
+};
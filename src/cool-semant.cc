@@ -596,9 +596,26 @@ Symbol *Arithmetic::typeCheckImpl(
   const Program *program,
   Symbol *currentType,
   ScopeContext &context) const {
-  Symbol *op1Type = op1->typeCheck(inheritanceTree, program, currentType, context);
-  Symbol *op2Type = op2->typeCheck(inheritanceTree, program, currentType, context);
+  // Walk the left spine bottom-up so that a long chain `a + b + c + ...` does
+  // not recurse once per operator. Every node of the chain but `this` gets its
+  // static type recorded here, `typeCheck` records the one of `this`.
+  std::vector<const Arithmetic *> nodes = spine();
+
+  Symbol *type = nodes.back()->op1->typeCheck(inheritanceTree, program, currentType, context);
+
+  for (auto iter = nodes.rbegin(), last = nodes.rend(); iter != last; iter++) {
+    const Arithmetic *node = *iter;
+    Symbol *op2Type = node->op2->typeCheck(inheritanceTree, program, currentType, context);
+    type = node->checkOperands(program, type, op2Type);
+    if (node != this) {
+      node->setStaticType(type);
+    }
+  }
+
+  return type;
+}
 
+Symbol *Arithmetic::checkOperands(const Program *program, Symbol *op1Type, Symbol *op2Type) const {
   /**
    * O,M,C |- e1 : Int
    * O,M,C |- e2 : Int
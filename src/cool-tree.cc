@@ -160,24 +160,38 @@ void IsVoid::dump(std::ostream &stream, std::vector<bool> &indents, const Progra
   indents.pop_back();
 }
 
+std::vector<const Arithmetic *> Arithmetic::spine(void) const {
+  std::vector<const Arithmetic *> nodes;
+  for (const Arithmetic *node = this; node; node = dynamic_cast<const Arithmetic *>(node->op1)) {
+    nodes.push_back(node);
+  }
+  return nodes;
+}
+
 void Arithmetic::dump(std::ostream &stream, std::vector<bool> &indents, const Program *program) const {
-  dump_indents(stream, indents);
-  stream << "Arithmetic.";
-  switch (op) {
-    case ArithmeticOperator::ADD: stream << "ADD"; break;
-    case ArithmeticOperator::SUB: stream << "SUB"; break;
-    case ArithmeticOperator::MUL: stream << "MUL"; break;
-    case ArithmeticOperator::DIV: stream << "DIV"; break;
+  std::vector<const Arithmetic *> nodes = spine();
+
+  for (const Arithmetic *node : nodes) {
+    dump_indents(stream, indents);
+    stream << "Arithmetic.";
+    switch (node->op) {
+      case ArithmeticOperator::ADD: stream << "ADD"; break;
+      case ArithmeticOperator::SUB: stream << "SUB"; break;
+      case ArithmeticOperator::MUL: stream << "MUL"; break;
+      case ArithmeticOperator::DIV: stream << "DIV"; break;
+    }
+    stream << "@" << program->getLine(node) << std::endl;
+
+    indents.push_back(false);
   }
-  stream << "@" << program->getLine(this) << std::endl;
 
-  indents.push_back(false);
-  op1->dump(stream, indents, program);
-  indents.pop_back();
+  nodes.back()->op1->dump(stream, indents, program);
 
-  indents.push_back(true);
-  op2->dump(stream, indents, program);
-  indents.pop_back();
+  for (auto iter = nodes.rbegin(), last = nodes.rend(); iter != last; iter++) {
+    indents.back() = true;
+    (*iter)->op2->dump(stream, indents, program);
+    indents.pop_back();
+  }
 }
 
 void Complement::dump(std::ostream &stream, std::vector<bool> &indents, const Program *program) const {
@@ -1,16 +1,23 @@
 #pragma once
 
+#include "cool-mips.h"
 #include "cool-type.h"
 #include "symtab.h"
 
 #include <ostream>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 class CGenContext;
+class Dispatch;
 class Environment;
+class FoldContext;
 class Program;
+class ReachContext;
+class RepresentationContext;
 class ScopeContext;
+class VoidContext;
 
 class TreeNode {
 public:
@@ -39,6 +46,10 @@ public:
     return staticType;
   }
 
+  void setStaticType(Symbol *type) const {
+    staticType = type;
+  }
+
   virtual void cgen(
     CGenContext &context,
     const InheritanceTree &inheritanceTree,
@@ -46,6 +57,105 @@ public:
     Symbol *currentType,
     Environment &env) const = 0;
 
+  /**
+   * @brief Generate the expression like `cgen`, but leave the raw value of the
+   * resulting Int or Bool object in $a0 instead of the object itself.
+   *
+   * The default boxes the value and loads it from the object.
+   */
+  virtual void cgenValue(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env) const;
+
+  /**
+   * @brief Generate the expression, of static type Bool, as a branch to
+   * `label` taken when its value is `jumpIf`, without a Bool object.
+   *
+   * The default branches on the raw value.
+   */
+  virtual void cgenBranch(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env,
+    bool jumpIf,
+    unsigned int label) const;
+
+  /**
+   * @brief Count the uses of the local variables of the expression that decide
+   * their representation, see `RepresentationContext`.
+   * @param value whether the expression is generated with `cgenValue`.
+   */
+  virtual void countUses(RepresentationContext &context, bool value) const = 0;
+
+  /**
+   * @return the number of nodes of the expression, which the inliner takes as
+   * the size of its code.
+   */
+  virtual unsigned int cost(void) const = 0;
+
+  /**
+   * @brief Record the classes instantiated and the methods called by the
+   * expression, see `ReachContext`.
+   */
+  virtual void reach(ReachContext &context) const = 0;
+
+  /**
+   * @brief Follow the local variables known not to be void through the
+   * expression, see `VoidContext`.
+   * @return whether the value of the expression is never void.
+   */
+  virtual bool nonVoid(VoidContext &context) const = 0;
+
+  /**
+   * @return whether evaluating the expression may call a method. Calls to the
+   * runtime routines do not count.
+   */
+  virtual bool callsMethod(void) const {
+    return true;
+  }
+
+  /**
+   * @return whether the expression has no side effects, so that it may be
+   * evaluated out of order.
+   */
+  virtual bool isPure(void) const {
+    return false;
+  }
+
+  /**
+   * @return the number of temporaries needed to evaluate the expression when
+   * pure operands are evaluated in the best order (its Sethi-Ullman number).
+   */
+  virtual unsigned int temporaries(void) const {
+    return 0;
+  }
+
+  /**
+   * @brief Add the dispatches in tail position of the expression, whose value
+   * is the value of the whole expression, to `calls`.
+   */
+  virtual void findTailCalls(std::unordered_set<const Dispatch *> &calls) const {}
+
+  /**
+   * @brief Static estimate of how often the code of the expression runs once
+   * reached, to lay out the branches of conditionals: negative if it ends the
+   * program with an error, positive if it runs a loop, 0 otherwise.
+   */
+  virtual int frequency(const InheritanceTree &inheritanceTree, Symbol *currentType) const {
+    return 0;
+  }
+
+  /**
+   * @brief Fold the constant subexpressions of the expression.
+   * @return the folded expression, which replaces this one.
+   */
+  virtual Expression *fold(FoldContext &context) = 0;
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
@@ -73,6 +183,23 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void cgenValue(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env) const override;
+
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
@@ -103,12 +230,38 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual void findTailCalls(std::unordered_set<const Dispatch *> &calls) const override;
+
+  virtual int frequency(const InheritanceTree &inheritanceTree, Symbol *currentType) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
     const Program *program,
     Symbol *currentType,
     ScopeContext &context) const override;
+
+  /**
+   * Generate the call as the body of `methodInfo`, its statically known
+   * target, in the frame of the caller.
+   */
+  void cgenInline(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env,
+    const MethodInfo *methodInfo) const;
 };
 
 class Conditional : public Expression {
@@ -132,12 +285,43 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void cgenValue(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env) const override;
+
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual void findTailCalls(std::unordered_set<const Dispatch *> &calls) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
     const Program *program,
     Symbol *currentType,
     ScopeContext &context) const override;
+
+  /**
+   * Generate the conditional with `cgenValue` on its branches if `value`,
+   * with `cgen` otherwise.
+   */
+  void cgenAs(
+    bool value,
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env) const;
 };
 
 class Loop : public Expression {
@@ -159,6 +343,18 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual int frequency(const InheritanceTree &inheritanceTree, Symbol *currentType) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
@@ -185,6 +381,27 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void cgenValue(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env) const override;
+
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual void findTailCalls(std::unordered_set<const Dispatch *> &calls) const override;
+
+  virtual int frequency(const InheritanceTree &inheritanceTree, Symbol *currentType) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
@@ -202,6 +419,18 @@ public:
   Definition(Symbol *name, Symbol *type, Expression *init = nullptr)
     : name(name), type(type), init(init) {}
 
+  Symbol *getName(void) const {
+    return name;
+  }
+
+  Symbol *getType(void) const {
+    return type;
+  }
+
+  Expression *getInit(void) const {
+    return init;
+  }
+
   virtual void dump(
     std::ostream &stream,
     std::vector<bool> &indents,
@@ -219,6 +448,16 @@ public:
     const Program *program,
     Symbol *currentType,
     Environment &env) const;
+
+  void countUses(RepresentationContext &context) const;
+
+  unsigned int cost(void) const;
+
+  void reach(ReachContext &context) const;
+
+  void nonVoid(VoidContext &context) const;
+
+  void fold(FoldContext &context);
 };
 
 class Let : public Expression {
@@ -241,6 +480,27 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void cgenValue(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env) const override;
+
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual void findTailCalls(std::unordered_set<const Dispatch *> &calls) const override;
+
+  virtual int frequency(const InheritanceTree &inheritanceTree, Symbol *currentType) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
@@ -273,13 +533,28 @@ public:
     Symbol *currentType,
     ScopeContext &context) const;
 
+  /**
+   * Bind the variable of the branch to the object in $a0 and generate the
+   * expression of the branch.
+   */
   void cgen(
     CGenContext &context,
     const InheritanceTree &inheritanceTree,
     const Program *program,
     Symbol *currentType,
-    Environment &env,
-    unsigned int esac_label) const;
+    Environment &env) const;
+
+  void countUses(RepresentationContext &context) const;
+
+  unsigned int cost(void) const;
+
+  void reach(ReachContext &context) const;
+
+  bool nonVoid(VoidContext &context) const;
+
+  void findTailCalls(std::unordered_set<const Dispatch *> &calls) const;
+
+  void fold(FoldContext &context);
 };
 
 class Case : public Expression {
@@ -302,6 +577,18 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual void findTailCalls(std::unordered_set<const Dispatch *> &calls) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
@@ -328,6 +615,16 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
@@ -354,6 +651,44 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void cgenValue(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env) const override;
+
+  virtual void cgenBranch(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env,
+    bool jumpIf,
+    unsigned int label) const override;
+
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
+  virtual bool callsMethod(void) const override {
+    return expr->callsMethod();
+  }
+
+  virtual bool isPure(void) const override {
+    return expr->isPure();
+  }
+
+  virtual unsigned int temporaries(void) const override {
+    return expr->temporaries();
+  }
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
@@ -373,6 +708,13 @@ public:
   Arithmetic(ArithmeticOperator op, Expression *op1, Expression *op2)
     : op(op), op1(op1), op2(op2) {}
 
+  /**
+   * Left-associative chains like `a + b + c + ...` nest along `op1`. Returns
+   * the nodes of that spine, starting with `this`, so that the passes can walk
+   * a chain iteratively instead of recursing once per operator.
+   */
+  std::vector<const Arithmetic *> spine(void) const;
+
   virtual void dump(
     std::ostream &stream,
     std::vector<bool> &indents,
@@ -385,12 +727,49 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void cgenValue(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env) const override;
+
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
+  virtual bool callsMethod(void) const override;
+
+  virtual bool isPure(void) const override;
+
+  virtual unsigned int temporaries(void) const override;
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
     const Program *program,
     Symbol *currentType,
     ScopeContext &context) const override;
+
+  Symbol *checkOperands(const Program *program, Symbol *op1Type, Symbol *op2Type) const;
+
+  /**
+   * Apply the operator to `lhs` and `rhs`, leaving the raw result in $a0.
+   */
+  void cgenOperation(CGenContext &context, Reg lhs, Reg rhs) const;
+
+  /**
+   * Apply the operator to the raw value in $a0 and the constant `value`, its
+   * right operand, or its left one if `constantFirst`, leaving the raw result
+   * in $a0.
+   */
+  void cgenConstantOperation(CGenContext &context, int value, bool constantFirst) const;
 };
 
 class Complement : public Expression {
@@ -411,6 +790,35 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void cgenValue(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env) const override;
+
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
+  virtual bool callsMethod(void) const override {
+    return expr->callsMethod();
+  }
+
+  virtual bool isPure(void) const override {
+    return expr->isPure();
+  }
+
+  virtual unsigned int temporaries(void) const override {
+    return expr->temporaries();
+  }
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
@@ -442,12 +850,74 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void cgenValue(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env) const override;
+
+  virtual void cgenBranch(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env,
+    bool jumpIf,
+    unsigned int label) const override;
+
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
+  virtual bool callsMethod(void) const override;
+
+  virtual bool isPure(void) const override;
+
+  virtual unsigned int temporaries(void) const override;
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
     const Program *program,
     Symbol *currentType,
     ScopeContext &context) const override;
+
+  /**
+   * @return whether both operands are Int or Bool, and compare as raw values
+   * rather than through `equality_test`.
+   */
+  bool comparesValues(void) const;
+
+  /**
+   * Evaluate the Int or Bool operands to raw values in `lhs` and `rhs`.
+   */
+  void cgenOperands(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env,
+    Reg &lhs,
+    Reg &rhs) const;
+
+  /**
+   * Compare objects that are not statically Int or Bool, leaving the raw
+   * result in $a0: they are equal if they are the same object, or if they are
+   * Int, Bool or String objects with the same value.
+   */
+  void cgenEquality(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env) const;
 };
 
 class Not : public Expression {
@@ -468,6 +938,44 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void cgenValue(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env) const override;
+
+  virtual void cgenBranch(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env,
+    bool jumpIf,
+    unsigned int label) const override;
+
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
+  virtual bool callsMethod(void) const override {
+    return expr->callsMethod();
+  }
+
+  virtual bool isPure(void) const override {
+    return expr->isPure();
+  }
+
+  virtual unsigned int temporaries(void) const override {
+    return expr->temporaries();
+  }
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
@@ -494,6 +1002,31 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void cgenValue(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env) const override;
+
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
+  virtual bool callsMethod(void) const override {
+    return false;
+  }
+
+  virtual bool isPure(void) const override {
+    return true;
+  }
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
@@ -508,6 +1041,10 @@ class Integer : public Expression {
 public:
   explicit Integer(int value) : value(value) {}
 
+  int getValue(void) const {
+    return value;
+  }
+
   virtual void dump(
     std::ostream &stream,
     std::vector<bool> &indents,
@@ -520,6 +1057,31 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void cgenValue(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env) const override;
+
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
+  virtual bool callsMethod(void) const override {
+    return false;
+  }
+
+  virtual bool isPure(void) const override {
+    return true;
+  }
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
@@ -534,6 +1096,10 @@ class String : public Expression {
 public:
   explicit String(const std::string &value) : value(value) {}
 
+  const std::string &getValue(void) const {
+    return value;
+  }
+
   virtual void dump(
     std::ostream &stream,
     std::vector<bool> &indents,
@@ -546,6 +1112,24 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
+  virtual bool callsMethod(void) const override {
+    return false;
+  }
+
+  virtual bool isPure(void) const override {
+    return true;
+  }
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
@@ -560,6 +1144,10 @@ class Boolean : public Expression {
 public:
   explicit Boolean(bool value) : value(value) {}
 
+  bool getValue(void) const {
+    return value;
+  }
+
   virtual void dump(
     std::ostream &stream,
     std::vector<bool> &indents,
@@ -572,6 +1160,31 @@ public:
     Symbol *currentType,
     Environment &env) const override;
 
+  virtual void cgenValue(
+    CGenContext &context,
+    const InheritanceTree &inheritanceTree,
+    const Program *program,
+    Symbol *currentType,
+    Environment &env) const override;
+
+  virtual void countUses(RepresentationContext &context, bool value) const override;
+
+  virtual unsigned int cost(void) const override;
+
+  virtual void reach(ReachContext &context) const override;
+
+  virtual bool nonVoid(VoidContext &context) const override;
+
+  virtual Expression *fold(FoldContext &context) override;
+
+  virtual bool callsMethod(void) const override {
+    return false;
+  }
+
+  virtual bool isPure(void) const override {
+    return true;
+  }
+
 private:
   virtual Symbol *typeCheckImpl(
     InheritanceTree &inheritanceTree,
@@ -1,9 +1,25 @@
 #include "cool-type.h"
 
+#include <algorithm>
 #include <stack>
 
 #define INVALID_INDEX UINT_MAX
 
+std::vector<const MethodInfo *> ClassInfo::getDispatchTable(void) const {
+  std::vector<const MethodInfo *> dispatchTable(dispatchSize, nullptr);
+
+  // The most derived definition of a slot wins
+  for (const ClassInfo *classInfo = this; classInfo; classInfo = classInfo->base) {
+    for (const MethodInfo *methodInfo : classInfo->ownMethods) {
+      if (!dispatchTable[methodInfo->index]) {
+        dispatchTable[methodInfo->index] = methodInfo;
+      }
+    }
+  }
+
+  return dispatchTable;
+}
+
 InheritanceTree::InheritanceTree(void) : fixed(false) {
   /* Install basic classes */
 
@@ -26,7 +42,7 @@ InheritanceTree::InheritanceTree(void) : fixed(false) {
     });
   installMethod(
     Symbol::Object,
-    strtab.new_string("abort"),
+    Symbol::abort,
     Symbol::Object,
     {},
     nullptr);
@@ -61,7 +77,6 @@ InheritanceTree::InheritanceTree(void) : fixed(false) {
         true,       // isPrimitive
         true,       // inheritable
         0,          // wordSize
-        root->dispatchTable,
       }
     });
   installMethod(
@@ -105,7 +120,6 @@ InheritanceTree::InheritanceTree(void) : fixed(false) {
         true,        // isPrimitive
         false,       // inheritable
         1,           // wordSize
-        root->dispatchTable,
       }
     });
 
@@ -124,7 +138,6 @@ InheritanceTree::InheritanceTree(void) : fixed(false) {
         true,           // isPrimitive
         false,          // inheritable
         2,              // wordSize
-        root->dispatchTable,
       }
     });
   installMethod(
@@ -163,7 +176,6 @@ InheritanceTree::InheritanceTree(void) : fixed(false) {
         true,         // isPrimitive
         false,        // inheritable
         1,            // wordSize
-        root->dispatchTable,
       }
     });
 }
@@ -296,6 +308,44 @@ const MethodInfo *InheritanceTree::getMethodInfo(Symbol *typeName, Symbol *methN
   return nullptr;
 }
 
+const MethodInfo *InheritanceTree::getUniqueMethodInfo(Symbol *typeName, Symbol *methName) const {
+  const ClassInfo *classInfo = getClassInfo(typeName);
+  const MethodInfo *methodInfo = getMethodInfo(typeName, methName);
+  if (!classInfo || !methodInfo) {
+    return nullptr;
+  }
+
+  // The classes conforming to `typeName` have the tags of its subtree. If one
+  // of them overrides the method, the topmost one overrides `methodInfo`
+  // directly.
+  const std::vector<unsigned int> &overriders = methodInfo->overriders;
+  auto iter = std::lower_bound(overriders.cbegin(), overriders.cend(), classInfo->tag);
+  if (iter != overriders.cend() && *iter < classInfo->tagEnd) {
+    return nullptr;
+  }
+  return methodInfo;
+}
+
+std::vector<std::pair<unsigned int, const MethodInfo *>> InheritanceTree::getDispatchTargets(
+  Symbol *typeName,
+  Symbol *methName,
+  const std::unordered_set<const ClassInfo *> *classes) const {
+  std::vector<std::pair<unsigned int, const MethodInfo *>> targets;
+
+  const ClassInfo *classInfo = getClassInfo(typeName);
+  for (unsigned int tag = classInfo->tag; tag < classInfo->tagEnd; tag++) {
+    if (classes && classes->count(classesByTag[tag]) == 0) {
+      continue;
+    }
+    const MethodInfo *methodInfo = getMethodInfo(classesByTag[tag]->typeName, methName);
+    if (targets.empty() || targets.back().second != methodInfo) {
+      targets.push_back({ tag, methodInfo });
+    }
+  }
+
+  return targets;
+}
+
 const ClassInfo *InheritanceTree::getClassInfo(Symbol *typeName) const {
   auto iter = dict.find(typeName);
   if (iter != dict.cend()) {
@@ -334,8 +384,7 @@ bool InheritanceTree::installClass(Symbol *name, Symbol *baseName) {
         base,           // base
         false,          // isPrimitive
         true,           // inheritable
-        base->wordSize, // wordSize
-        base->dispatchTable,
+        0,              // wordSize
       }
     });
 
@@ -379,11 +428,8 @@ bool InheritanceTree::installMethod(Symbol *typeName, Symbol *methName, Symbol *
   Node &node = nodes[iter->second];
   ClassInfo *classInfo = node.classInfo;
 
-  const MethodInfo *baseMethodInfo = getMethodInfo(typeName, methName);
-  unsigned int index = baseMethodInfo ?
-    baseMethodInfo->index :
-    static_cast<unsigned int>(classInfo->dispatchTable.size());
-
+  // The dispatch slot is assigned by `fix`, when the methods of all the base
+  // classes are known.
   auto insertion = classInfo->methods.insert({
     methName,
     new MethodInfo {
@@ -391,17 +437,12 @@ bool InheritanceTree::installMethod(Symbol *typeName, Symbol *methName, Symbol *
       methName,
       { retType, paramDecls },
       expr,
-      index
+      INVALID_INDEX
     },
   });
 
   if (insertion.second) {
-    MethodInfo *methodInfo = insertion.first->second;
-    if (baseMethodInfo) {
-      classInfo->dispatchTable[index] = methodInfo;
-    } else {
-      classInfo->dispatchTable.push_back(methodInfo);
-    }
+    classInfo->ownMethods.push_back(insertion.first->second);
     return true;
   }
 
@@ -432,6 +473,36 @@ void InheritanceTree::fix(void) {
     }
     else {
       classInfo->tag = tag++;
+      classesByTag.push_back(classInfo);
+
+      // Base classes are visited first, so their slots are already laid out:
+      // a method either overrides an inherited slot or appends a new one.
+      // Classes are numbered in this order, so the overriders of a method
+      // are recorded by increasing tag.
+      const ClassInfo *baseClassInfo = classInfo->base;
+      classInfo->dispatchSize = baseClassInfo ? baseClassInfo->dispatchSize : 0;
+      for (MethodInfo *methodInfo : classInfo->ownMethods) {
+        const MethodInfo *baseMethodInfo = baseClassInfo ?
+          getMethodInfo(baseClassInfo->typeName, methodInfo->methName) :
+          nullptr;
+        if (baseMethodInfo) {
+          methodInfo->index = baseMethodInfo->index;
+          baseMethodInfo->overriders.push_back(classInfo->tag);
+        }
+        else {
+          methodInfo->index = classInfo->dispatchSize++;
+        }
+      }
+
+      // Attributes are numbered per class when they are installed, the
+      // inherited ones come first in the object layout.
+      if (baseClassInfo) {
+        for (auto &attribute : classInfo->attributes) {
+          attribute.second->wordOffset += baseClassInfo->wordSize;
+        }
+        classInfo->wordSize += baseClassInfo->wordSize;
+      }
+
       const std::vector<ClassInfo *> edges = graph[classInfo];
       for (auto iter = edges.rbegin(), last = edges.rend(); iter != last; iter++) {
         stack.push({ *iter, false });
@@ -3,6 +3,7 @@
 #include "strtab.h"
 
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 class Expression;
@@ -25,6 +26,9 @@ struct MethodInfo {
   Expression *expr;
   unsigned int index;
   mutable unsigned int locals;
+  /* Tags of the classes that override the method directly, in increasing
+   * order */
+  mutable std::vector<unsigned int> overriders;
 };
 
 struct ClassInfo {
@@ -33,11 +37,24 @@ struct ClassInfo {
   bool isPrimitive;
   bool inheritable;
   unsigned int wordSize;
-  std::vector<MethodInfo *> dispatchTable;
+  /* Methods defined by the class itself, in order of definition */
+  std::vector<MethodInfo *> ownMethods;
   std::unordered_map<Symbol *, MethodInfo *> methods;
   std::unordered_map<Symbol *, AttributeInfo *> attributes;
   unsigned int tag;
   unsigned int tagEnd;
+  unsigned int dispatchSize;
+
+  /**
+   * @brief Expand the dispatch table of the class
+   *
+   * A class only stores the methods it defines itself, the slots it inherits
+   * unchanged are shared with its base classes. The full table is built on
+   * demand, which only the code generator needs.
+   *
+   * @return std::vector<const MethodInfo *>
+   */
+  std::vector<const MethodInfo *> getDispatchTable(void) const;
 };
 
 class InheritanceTree {
@@ -52,6 +69,9 @@ class InheritanceTree {
   std::vector<Node> nodes;
   std::unordered_map<Symbol *, unsigned int> dict;
 
+  /* Classes indexed by tag, set by `fix` */
+  std::vector<const ClassInfo *> classesByTag;
+
 public:
   InheritanceTree(void);
 
@@ -79,6 +99,33 @@ public:
 
   const ClassInfo *getClassInfo(Symbol *typeName) const;
 
+  /**
+   * @return the definition of `methName` that every object conforming to
+   * `typeName` dispatches to, or `nullptr` if a derived class overrides it.
+   */
+  const MethodInfo *getUniqueMethodInfo(Symbol *typeName, Symbol *methName) const;
+
+  /**
+   * @brief The definitions of `methName` that the objects conforming to
+   * `typeName` dispatch to, by ranges of class tags.
+   *
+   * @param classes if set, only the objects of these classes are considered,
+   * the tags of the other classes may fall in any range.
+   * @return (first tag, method) pairs in the order of the tags: the classes
+   * from one tag up to the next pair dispatch to the same method.
+   */
+  std::vector<std::pair<unsigned int, const MethodInfo *>> getDispatchTargets(
+    Symbol *typeName,
+    Symbol *methName,
+    const std::unordered_set<const ClassInfo *> *classes = nullptr) const;
+
+  /**
+   * @return the classes in the order of their tags, set by `fix`.
+   */
+  const std::vector<const ClassInfo *> &getClasses(void) const {
+    return classesByTag;
+  }
+
   bool installClass(Symbol *name, Symbol *baseName);
 
   bool installAttribute(Symbol *typeName, Symbol *attrName, Symbol *attrType, Expression *init);
@@ -0,0 +1,183 @@
+#include "cool-void.h"
+
+#include <algorithm>
+
+void VoidContext::assign(Symbol *name, bool nonVoid) {
+  int index;
+  if (scope.lookup(name, index)) {
+    state[index] = nonVoid;
+  }
+}
+
+bool VoidContext::isNonVoid(Symbol *name) const {
+  int index;
+  return scope.lookup(name, index) && state[index];
+}
+
+void VoidContext::join(const std::vector<bool> &other) {
+  state.resize(std::min(state.size(), other.size()));
+  for (size_t i = 0; i < state.size(); i++) {
+    state[i] = state[i] && other[i];
+  }
+}
+
+/**
+ * @brief Visit `expr`.
+ * @return whether its value is never void. The values of the basic types never
+ * are: their variables start with a default object, and nothing else has
+ * these types.
+ */
+static bool visit(VoidContext &context, const Expression *expr) {
+  bool nonVoid = expr->nonVoid(context);
+  Symbol *type = expr->getStaticType();
+  return nonVoid || type == Symbol::Int || type == Symbol::Bool || type == Symbol::String;
+}
+
+bool Assign::nonVoid(VoidContext &context) const {
+  bool nonVoid = visit(context, expr);
+  context.assign(left, nonVoid);
+  return nonVoid;
+}
+
+bool Dispatch::nonVoid(VoidContext &context) const {
+  for (Expression *arg : args) {
+    visit(context, arg);
+  }
+  context.setNonVoid(this, expr ? visit(context, expr) : true);
+  return false;
+}
+
+bool Conditional::nonVoid(VoidContext &context) const {
+  visit(context, pred);
+  std::vector<bool> state = context.getState();
+  bool nonVoid = visit(context, then);
+  std::vector<bool> thenState = context.getState();
+  context.setState(state);
+  nonVoid = visit(context, elSe) && nonVoid;
+  context.join(thenState);
+  return nonVoid;
+}
+
+bool Loop::nonVoid(VoidContext &context) const {
+  std::vector<bool> head;
+  do {
+    head = context.getState();
+    visit(context, pred);
+    visit(context, body);
+    context.join(head);
+  } while (context.getState() != head);
+
+  // The loop exits after the test
+  visit(context, pred);
+  return false;
+}
+
+bool Block::nonVoid(VoidContext &context) const {
+  bool nonVoid = false;
+  for (Expression *expr : exprs) {
+    nonVoid = visit(context, expr);
+  }
+  return nonVoid;
+}
+
+void Definition::nonVoid(VoidContext &context) const {
+  if (init) {
+    context.define(name, visit(context, init));
+  }
+  else {
+    context.define(name, type == Symbol::Int || type == Symbol::Bool || type == Symbol::String);
+  }
+}
+
+bool Let::nonVoid(VoidContext &context) const {
+  context.enterScope();
+  for (Definition *def : defs) {
+    def->nonVoid(context);
+  }
+  bool nonVoid = visit(context, body);
+  context.leaveScope();
+  return nonVoid;
+}
+
+bool Branch::nonVoid(VoidContext &context) const {
+  // A branch never matches void
+  context.enterScope();
+  context.define(name, true);
+  bool nonVoid = visit(context, expr);
+  context.leaveScope();
+  return nonVoid;
+}
+
+bool Case::nonVoid(VoidContext &context) const {
+  context.setNonVoid(this, visit(context, expr));
+
+  std::vector<bool> state = context.getState();
+  std::vector<bool> joined;
+  bool nonVoid = true;
+  for (size_t i = 0; i < branches.size(); i++) {
+    context.setState(state);
+    nonVoid = branches[i]->nonVoid(context) && nonVoid;
+    if (i > 0) {
+      context.join(joined);
+    }
+    joined = context.getState();
+  }
+  return nonVoid;
+}
+
+bool New::nonVoid(VoidContext &context) const {
+  return true;
+}
+
+bool IsVoid::nonVoid(VoidContext &context) const {
+  visit(context, expr);
+  return true;
+}
+
+bool Arithmetic::nonVoid(VoidContext &context) const {
+  std::vector<const Arithmetic *> nodes = spine();
+  visit(context, nodes.back()->op1);
+  for (const Arithmetic *node : nodes) {
+    visit(context, node->op2);
+  }
+  return true;
+}
+
+bool Complement::nonVoid(VoidContext &context) const {
+  visit(context, expr);
+  return true;
+}
+
+bool Comparison::nonVoid(VoidContext &context) const {
+  visit(context, op1);
+  visit(context, op2);
+  return true;
+}
+
+bool Not::nonVoid(VoidContext &context) const {
+  visit(context, expr);
+  return true;
+}
+
+bool Object::nonVoid(VoidContext &context) const {
+  return name == Symbol::self || context.isNonVoid(name);
+}
+
+bool Integer::nonVoid(VoidContext &context) const {
+  return true;
+}
+
+bool String::nonVoid(VoidContext &context) const {
+  return true;
+}
+
+bool Boolean::nonVoid(VoidContext &context) const {
+  return true;
+}
+
+void findNonVoid(const std::vector<const Expression *> &exprs, std::unordered_set<const Expression *> &unchecked) {
+  for (const Expression *expr : exprs) {
+    VoidContext context(unchecked);
+    visit(context, expr);
+  }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "cool-tree.h"
+#include "symtab.h"
+
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Flow-sensitive analysis of the local variables that cannot be void, over the
+ * body of one method or attribute initializer, visited in evaluation order.
+ *
+ * The state at each point tells, for each variable in scope, whether it holds
+ * an object on all the paths reaching that point. A variable is known not to
+ * be void after being defined or assigned a value that is never void: `self`,
+ * a new object, a value of a basic type, or such a variable. Paths join by
+ * intersection, and loop bodies are revisited until the state at the head of
+ * the loop is stable. Nothing is assumed about the formal parameters and the
+ * attributes, which callers and other methods may set to void.
+ *
+ * The dispatches and case expressions whose receiver or scrutinee is never void
+ * need no runtime check, they are added to the output set.
+ */
+class VoidContext {
+  /* Index into `state` of the `let` and `case` variables in scope */
+  Symtab<int> scope;
+  std::vector<bool> state;
+  /* Size of `state` at the start of each open scope */
+  std::vector<size_t> scopeSizes;
+
+  std::unordered_set<const Expression *> &unchecked;
+
+public:
+  explicit VoidContext(std::unordered_set<const Expression *> &unchecked) : unchecked(unchecked) {}
+
+  void enterScope(void) {
+    scope.enterScope();
+    scopeSizes.push_back(state.size());
+  }
+
+  void leaveScope(void) {
+    scope.leaveScope();
+    state.resize(scopeSizes.back());
+    scopeSizes.pop_back();
+  }
+
+  /**
+   * @brief Bind the variable `name` in the current scope.
+   * @param nonVoid whether its initial value is never void.
+   */
+  void define(Symbol *name, bool nonVoid) {
+    scope.define(name, static_cast<int>(state.size()));
+    state.push_back(nonVoid);
+  }
+
+  /**
+   * @brief Record the assignment to `name` of a value that is never void if
+   * `nonVoid`. Assignments to parameters and attributes are not followed.
+   */
+  void assign(Symbol *name, bool nonVoid);
+
+  /**
+   * @return whether the variable `name` is known not to be void at this point.
+   */
+  bool isNonVoid(Symbol *name) const;
+
+  const std::vector<bool> &getState(void) const {
+    return state;
+  }
+
+  void setState(const std::vector<bool> &value) {
+    state = value;
+  }
+
+  /**
+   * @brief Join the paths reaching this point with the ones in `other`: a
+   * variable stays known not to be void only if it is in both.
+   */
+  void join(const std::vector<bool> &other);
+
+  /**
+   * @brief Record whether the receiver of the dispatch or the scrutinee of
+   * the case expression `node` is never void.
+   *
+   * Loop bodies are visited several times, the last visit is the one with
+   * the stable state.
+   */
+  void setNonVoid(const Expression *node, bool nonVoid) {
+    if (nonVoid) {
+      unchecked.insert(node);
+    }
+    else {
+      unchecked.erase(node);
+    }
+  }
+};
+
+/**
+ * @brief Add the dispatches and case expressions of `exprs`, bodies of methods
+ * or attribute initializers, that need no void check to `unchecked`.
+ */
+void findNonVoid(const std::vector<const Expression *> &exprs, std::unordered_set<const Expression *> &unchecked);
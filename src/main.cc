@@ -1,21 +1,65 @@
 #include "cool-cgen.h"
+#include "cool-fold.h"
 #include "cool-lex.h"
 #include "cool-semant.h"
 #include "utilities.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <thread>
 #include <vector>
 
 int main(int argc, char *argv[]) {
   int opt_index = 1;
 
+  const char *outFilename = nullptr;
+  bool object = false;
+  bool optimize = true;
+  bool verbose = false;
+  unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
   std::vector<Program *> programs;
 
   while (opt_index < argc) {
     const char *filename = argv[opt_index++];
 
+    if (std::strcmp(filename, "-j") == 0) {
+      int count = opt_index < argc ? std::atoi(argv[opt_index++]) : 0;
+      if (count <= 0) {
+        std::cerr << "Missing or invalid thread count after -j" << std::endl;
+        return -1;
+      }
+      threads = static_cast<unsigned int>(count);
+      continue;
+    }
+
+    if (std::strcmp(filename, "-O0") == 0) {
+      optimize = false;
+      continue;
+    }
+
+    if (std::strcmp(filename, "-v") == 0) {
+      verbose = true;
+      continue;
+    }
+
+    if (std::strcmp(filename, "-c") == 0) {
+      object = true;
+      continue;
+    }
+
+    if (std::strcmp(filename, "-o") == 0) {
+      if (opt_index == argc) {
+        std::cerr << "Missing file name after -o" << std::endl;
+        return -1;
+      }
+      outFilename = argv[opt_index++];
+      continue;
+    }
+
     std::ifstream stream(filename, std::ios::binary);
     if (!stream) {
       std::cerr << "Could not open input file " << filename << std::endl;
@@ -55,9 +99,33 @@ int main(int argc, char *argv[]) {
 
   inheritanceTree.fix();
 
-  CGenContext context(std::cout);
+  if (optimize) {
+    fold(inheritanceTree, programs);
+  }
+
+  CGenContext context(threads, optimize);
   context.cgen(inheritanceTree, programs);
 
+  if (verbose) {
+    context.getPeepholeStats().print(std::cerr);
+    context.getDispatchStats().print(std::cerr);
+    context.getVoidCheckStats().print(std::cerr);
+    context.getFrameStats().print(std::cerr);
+    if (const ReachContext *reachability = context.getReachability()) {
+      reachability->print(std::cerr);
+    }
+  }
+
+  if (outFilename) {
+    std::ofstream stream(outFilename, std::ios::binary);
+    if (!stream || !(object ? context.writeObject(stream) : context.write(stream))) {
+      std::cerr << "Could not write output file " << outFilename << std::endl;
+      return -1;
+    }
+  } else if (!(object ? context.writeObject(std::cout) : context.write(std::cout))) {
+    return -1;
+  }
+
   for (Program *program : programs) {
     delete program;
   }
@@ -0,0 +1,29 @@
+#include "outbuf.h"
+
+OutBuffer &OutBuffer::operator<<(unsigned int value) {
+  char digits[10];
+  char *first = digits + sizeof(digits);
+
+  do {
+    *--first = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value);
+
+  data.append(first, digits + sizeof(digits));
+  return *this;
+}
+
+OutBuffer &OutBuffer::operator<<(int value) {
+  if (value < 0) {
+    data.push_back('-');
+    // Negate in unsigned arithmetic, INT_MIN has no positive counterpart
+    return *this << (0u - static_cast<unsigned int>(value));
+  }
+  return *this << static_cast<unsigned int>(value);
+}
+
+bool OutBuffer::write(std::ostream &stream) const {
+  stream.write(data.data(), static_cast<std::streamsize>(data.size()));
+  stream.flush();
+  return static_cast<bool>(stream);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+
+/**
+ * Append-only text buffer for the generated assembly.
+ *
+ * The whole output is formatted in memory and handed over to the output
+ * stream in a single write, instead of flushing the stream once per emitted
+ * line. Integers are formatted by hand to stay clear of the locale machinery
+ * of iostreams.
+ */
+class OutBuffer {
+  std::string data;
+
+public:
+  explicit OutBuffer(size_t capacity = 1 << 20) {
+    data.reserve(capacity);
+  }
+
+  OutBuffer(const OutBuffer &) = delete;
+  OutBuffer &operator=(const OutBuffer &) = delete;
+
+  OutBuffer(OutBuffer &&) = default;
+  OutBuffer &operator=(OutBuffer &&) = default;
+
+  OutBuffer &operator<<(char c) {
+    data.push_back(c);
+    return *this;
+  }
+
+  OutBuffer &operator<<(const char *str) {
+    data.append(str);
+    return *this;
+  }
+
+  OutBuffer &operator<<(const std::string &str) {
+    data.append(str);
+    return *this;
+  }
+
+  OutBuffer &operator<<(unsigned int value);
+
+  OutBuffer &operator<<(int value);
+
+  size_t size(void) const {
+    return data.size();
+  }
+
+  bool write(std::ostream &stream) const;
+};
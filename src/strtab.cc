@@ -8,6 +8,7 @@ Symbol *const Symbol::Int       = strtab.new_string("Int");
 Symbol *const Symbol::Object    = strtab.new_string("Object");
 Symbol *const Symbol::SELF_TYPE = strtab.new_string("SELF_TYPE");
 Symbol *const Symbol::String    = strtab.new_string("String");
+Symbol *const Symbol::abort     = strtab.new_string("abort");
 Symbol *const Symbol::self      = strtab.new_string("self");
 
 Strtab::~Strtab(void) {
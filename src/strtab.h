@@ -13,6 +13,7 @@ public:
   static Symbol *const Object;
   static Symbol *const SELF_TYPE;
   static Symbol *const String;
+  static Symbol *const abort;
   static Symbol *const self;
 
   explicit Symbol(const std::string &str) : str(str) {}
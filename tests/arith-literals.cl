@@ -0,0 +1,88 @@
+(* multiplication and division by integer literals, checked against the same
+   operations on a variable: each row prints the quotients by the literals,
+   then "ok" if every result matches *)
+class Main inherits IO {
+    failures : Int;
+
+    (* the divisors and factors as variables, so they stay out of the
+       literal paths *)
+    one : Int <- 1;
+    two : Int <- 2;
+    three : Int <- 3;
+    seven : Int <- 7;
+    eight : Int <- 8;
+    ten : Int <- 10;
+    big : Int <- 65536;
+    max : Int <- 2147483647;
+
+    check(value : Int, expected : Int) : Int {
+        {
+            if value = expected then 0 else failures <- failures + 1 fi;
+            out_int(value).out_string(" ");
+            value;
+        }
+    };
+
+    divide(x : Int) : Object {
+        {
+            out_int(x).out_string(": ");
+            check(x / 1, x / one);
+            if x = ~max - 1 then 0 else check(x / ~1, x / ~one) fi;
+            check(x / 2, x / two);
+            check(x / ~2, x / ~two);
+            check(x / 8, x / eight);
+            check(x / ~8, x / ~eight);
+            check(x / 65536, x / big);
+            check(x / 3, x / three);
+            check(x / ~3, x / ~three);
+            check(x / 7, x / seven);
+            check(x / ~7, x / ~seven);
+            check(x / 10, x / ten);
+            check(x / 641, x / (ten * 64 + one));
+            check(x / 2147483647, x / max);
+            check(x / ~2147483647, x / ~max);
+            out_string("\n");
+        }
+    };
+
+    multiply(x : Int) : Object {
+        {
+            out_int(x).out_string(": ");
+            check(x * 0, x * (one - one));
+            check(x * 1, x * one);
+            check(x * ~1, x * ~one);
+            check(2 * x, two * x);
+            check(x * 3, x * three);
+            check(x * ~8, x * ~eight);
+            check(x * 10, x * ten);
+            check(x * 65537, x * (big + one));
+            out_string("\n");
+        }
+    };
+
+    main() : Object {
+        {
+            divide(0);
+            divide(1);
+            divide(6);
+            divide(7);
+            divide(100);
+            divide(12345678);
+            divide(max);
+            divide(max - 1);
+            divide(~1);
+            divide(~6);
+            divide(~7);
+            divide(~100);
+            divide(~12345678);
+            divide(~max);
+            divide(~max - 1);
+            multiply(0);
+            multiply(7);
+            multiply(~7);
+            multiply(12345);
+            multiply(~12345);
+            if failures = 0 then out_string("ok\n") else out_int(failures).out_string(" failures\n") fi;
+        }
+    };
+};
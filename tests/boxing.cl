@@ -0,0 +1,91 @@
+(* Int and Bool locals kept unboxed are boxed where they escape: assigned to
+   attributes, passed as arguments, returned, and matched by case *)
+class Box {
+    value : Object;
+
+    set(v : Object) : Box { { value <- v; self; } };
+
+    get() : Object { value };
+};
+
+class Main inherits IO {
+    count : Int;
+    flag : Bool;
+    any : Object;
+
+    show(o : Object) : Object {
+        case o of
+            i : Int => out_string(o.type_name()).out_string(" ").out_int(i).out_string("\n");
+            b : Bool => out_string(o.type_name()).out_string(if b then " true\n" else " false\n" fi);
+            x : Object => out_string(o.type_name()).out_string("\n");
+        esac
+    };
+
+    sum(a : Int, b : Int) : Int { a + b };
+
+    (* returned from methods of static type Int and Object *)
+    counted(n : Int) : Int {
+        let i : Int <- 0, total : Int <- 0 in {
+            while i < n loop { total <- total + i; i <- i + 1; } pool;
+            total;
+        }
+    };
+
+    counted_object(n : Int) : Object {
+        let i : Int <- 0, total : Int <- 0 in {
+            while i < n loop { total <- total + i; i <- i + 1; } pool;
+            total;
+        }
+    };
+
+    negated(b : Bool) : Object {
+        let c : Bool <- not b in c
+    };
+
+    main() : Object {
+        let i : Int <- 40, b : Bool <- false, box : Box <- new Box in {
+            i <- i + 2;
+            b <- i = 42;
+
+            -- assigned to attributes
+            count <- i;
+            flag <- b;
+            any <- i;
+            show(count);
+            show(flag);
+            show(any);
+            any <- b;
+            show(any);
+
+            -- passed as arguments
+            show(i);
+            show(b);
+            out_int(sum(i, i)).out_string("\n");
+            show(box.set(i).get());
+            show(box.set(b).get());
+
+            -- returned
+            show(counted(10));
+            show(counted_object(10));
+            show(negated(b));
+
+            -- matched by case
+            case i of
+                x : Int => out_int(x + 1).out_string("\n");
+                o : Object => out_string("Object\n");
+            esac;
+            case b of
+                x : Bool => out_string(if x then "true\n" else "false\n" fi);
+                o : Object => out_string("Object\n");
+            esac;
+            let j : Int <- i * 2 in case j of o : Object => show(o); esac;
+
+            -- the boxed copies keep their values after the locals change
+            i <- 0;
+            b <- false;
+            show(count);
+            show(flag);
+            show(box.get());
+        }
+    };
+};
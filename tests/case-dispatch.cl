@@ -0,0 +1,80 @@
+(* case expressions over a dense hierarchy, dispatched by a jump table, and
+   over a sparse one, dispatched by a search over tag ranges; the last case
+   has no matching branch and aborts *)
+class Dense {};
+
+class D1 inherits Dense {};
+class D2 inherits Dense {};
+class D3 inherits Dense {};
+class D4 inherits Dense {};
+class D5 inherits Dense {};
+class D6 inherits D5 {};
+
+class Sparse {};
+
+class S1 inherits Sparse {};
+class S1a inherits S1 {};
+class S1b inherits S1 {};
+class S1c inherits S1 {};
+class S1d inherits S1 {};
+class S2 inherits Sparse {};
+class S2a inherits S2 {};
+class S2b inherits S2 {};
+class S2c inherits S2 {};
+class S2d inherits S2 {};
+class S3 inherits Sparse {};
+class S3a inherits S3 {};
+class S3b inherits S3 {};
+class S3c inherits S3 {};
+class S3d inherits S3 {};
+class S4 inherits Sparse {};
+class S4a inherits S4 {};
+class S4b inherits S4 {};
+class S4c inherits S4 {};
+class S4d inherits S4 {};
+class S5 inherits Sparse {};
+class S5a inherits S5 {};
+class S5b inherits S5 {};
+class S5c inherits S5 {};
+class S5d inherits S5 {};
+
+class Main inherits IO {
+    dense(d : Dense) : Object {
+        out_string(
+            case d of
+                x : D1 => "D1";
+                x : D2 => "D2";
+                x : D3 => "D3";
+                x : D4 => "D4";
+                x : D5 => "D5";
+                x : D6 => "D6";
+            esac
+        ).out_string(" ")
+    };
+
+    sparse(s : Sparse) : Object {
+        out_string(
+            case s of
+                x : Sparse => "Sparse";
+                x : S1 => "S1";
+                x : S3 => "S3";
+                x : S5 => "S5";
+            esac
+        ).out_string(" ")
+    };
+
+    main() : Object {
+        {
+            dense(new D1); dense(new D2); dense(new D3);
+            dense(new D4); dense(new D5); dense(new D6);
+            out_string("\n");
+            sparse(new Sparse); sparse(new S1); sparse(new S1c);
+            sparse(new S2); sparse(new S2d); sparse(new S3a);
+            sparse(new S4); sparse(new S4b); sparse(new S5);
+            sparse(new S5d);
+            out_string("\n");
+            dense(new Dense);
+            out_string("unreachable\n");
+        }
+    };
+};
@@ -0,0 +1,15 @@
+(* a case on void aborts before matching any branch *)
+class Main inherits IO {
+    o : Object;
+
+    main() : Object {
+        {
+            out_string("before\n");
+            case o of
+                x : Int => out_string("Int\n");
+                x : Object => out_string("Object\n");
+            esac;
+            out_string("unreachable\n");
+        }
+    };
+};
@@ -0,0 +1,25 @@
+(* constants folded into operands of a wider static type still compare as
+   objects: each line prints "different" *)
+class Main inherits IO {
+    o : Object;
+    y : Object <- 5;
+    one : Object <- 1;
+
+    report(equal : Bool) : SELF_TYPE {
+        if equal then out_string("equal\n") else out_string("different\n") fi
+    };
+
+    main() : SELF_TYPE {
+        {
+            let x : Object <- 5 in report(x = new Object);
+            let x : Object <- 5 in report(x = o);
+            let x : Object <- 6 in report(x = y);
+            report((if true then 5 else o fi) = new Object);
+            report((if true then 5 else o fi) = o);
+            report((if false then o else 6 fi) = y);
+            report(o = (let x : Object <- true in x));
+            let x : Object <- true in report(x = one);
+            report((if true then true else o fi) = one);
+        }
+    };
+};
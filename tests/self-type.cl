@@ -0,0 +1,43 @@
+(* new SELF_TYPE allocates an object of the dynamic type of self, through
+   class_objTab *)
+class A inherits IO {
+    n : Int <- 1;
+
+    dup() : SELF_TYPE {
+        new SELF_TYPE
+    };
+
+    name() : String {
+        "A"
+    };
+
+    show() : SELF_TYPE {
+        out_string(name()).out_int(n).out_string("\n")
+    };
+};
+
+class B inherits A {
+    m : Int <- 2;
+
+    name() : String {
+        "B"
+    };
+};
+
+class C inherits B {
+    name() : String {
+        "C"
+    };
+};
+
+class Main {
+    main() : Object {
+        {
+            (new A).dup().show();
+            (new B).dup().show();
+            (new C).dup().show();
+            let a : A <- new C in a.dup().show();
+            let b : B <- new B in b.dup().dup().show();
+        }
+    };
+};
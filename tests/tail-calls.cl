@@ -0,0 +1,60 @@
+(* calls in tail position reuse the frame of the caller: without that, the
+   recursions below run 100000 levels deep *)
+class List {
+    next() : List { { abort(); self; } };
+};
+
+class Cons inherits List {
+    rest : List;
+
+    init(tail : List) : Cons { { rest <- tail; self; } };
+
+    next() : List { rest };
+};
+
+class Walker {
+    (* self tail call, in a loop as deep as n *)
+    count(n : Int, acc : Int) : Int {
+        if n = 0 then acc else count(n - 1, acc + 1) fi
+    };
+
+    (* tail calls to methods with fewer arguments than the caller *)
+    three(n : Int, a : Int, b : Int) : Int {
+        if n = 0 then a + b else two(n - 1, a + 1) fi
+    };
+
+    two(n : Int, a : Int) : Int {
+        if n = 0 then a else one(n - 1) fi
+    };
+
+    one(n : Int) : Int {
+        if n = 0 then 0 else three(n - 1, n, 1) fi
+    };
+
+    even(n : Int) : Bool { if n = 0 then true else odd(n - 1) fi };
+
+    odd(n : Int) : Bool { if n = 0 then false else even(n - 1) fi };
+
+    (* tail calls in the bodies of case branches and let *)
+    length(l : List, n : Int) : Int {
+        case l of
+            c : Cons => let tail : List <- c.next() in length(tail, n + 1);
+            e : List => n;
+        esac
+    };
+
+    build(n : Int, l : List) : List {
+        if n = 0 then l else let c : Cons <- (new Cons).init(l) in build(n - 1, c) fi
+    };
+};
+
+class Main inherits IO {
+    main() : Object {
+        let w : Walker <- new Walker in {
+            out_int(w.count(100000, 0)).out_string("\n");
+            out_int(w.three(100000, 0, 0)).out_string("\n");
+            out_string(if w.even(100001) then "even\n" else "odd\n" fi);
+            out_int(w.length(w.build(100000, new List), 0)).out_string("\n");
+        }
+    };
+};